@@ -0,0 +1,93 @@
+/*
+ * spawn
+ * start of a command by fork and exec, by popen, and by util::exec with
+ * posix_spawn. "bench/spawn 2048" first maps and touches 2 GB, as a big
+ * agent would have, which fork has to copy the page tables of
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lib/util.h"
+
+// output of argv, read from a pipe of a forked child
+static std::string forked( const std::vector<std::string>& argv ) {
+    int fds[2];
+    if ( pipe( fds ) != 0 ) return std::string();
+
+    std::vector<char*> args;
+    for ( auto& a : argv ) args.push_back( const_cast<char*>( a.c_str() ) );
+    args.push_back( nullptr );
+
+    pid_t pid = fork();
+    if ( pid == 0 ) {
+        dup2( fds[1], STDOUT_FILENO );
+        close( fds[0] );
+        close( fds[1] );
+        execvp( args[0], args.data() );
+        _exit( 127 );
+    }
+    close( fds[1] );
+
+    std::string result;
+    char        buffer[4096];
+    ssize_t     n;
+    while ( ( n = read( fds[0], buffer, sizeof( buffer ) ) ) > 0 )
+        result.append( buffer, n );
+    close( fds[0] );
+    waitpid( pid, nullptr, 0 );
+    return result;
+}
+
+// output of cmd by popen and fgets, as util::exec read it before
+static std::string popened( const char* cmd ) {
+    std::string result;
+    char        buffer[4096];
+    FILE*       pipe = popen( cmd, "r" );
+    if ( !pipe ) return result;
+    while ( fgets( buffer, sizeof( buffer ), pipe ) ) result += buffer;
+    pclose( pipe );
+    return result;
+}
+
+template <typename F>
+static void run( const char* name, int rounds, F f ) {
+    typedef std::chrono::steady_clock clock;
+
+    auto t0 = clock::now();
+    for ( int i = 0; i < rounds; ++i ) f();
+    double s = std::chrono::duration<double>( clock::now() - t0 ).count();
+
+    std::printf( "%-24s %8.0f /s %8.1f us\n", name, rounds / s,
+                 s / rounds * 1e6 );
+}
+
+int main( int argc, char** argv ) {
+    std::size_t mb = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 0;
+    if ( mb ) {
+        auto p = static_cast<char*>(
+            mmap( nullptr, mb << 20, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) );
+        if ( p == MAP_FAILED ) return 1;
+        std::memset( p, 1, mb << 20 );
+    }
+    std::printf( "%zu MB mapped\n", mb );
+
+    const int                rounds = 1000;
+    std::vector<std::string> echo   = {"echo", "hi"};
+
+    run( "fork sh -c echo hi", rounds,
+         [] { forked( util::shell( "echo hi" ) ); } );
+    run( "popen sh -c echo hi", rounds, [] { popened( "echo hi" ); } );
+    run( "spawn sh -c echo hi", rounds, [] { util::exec( "echo hi", false ); } );
+    run( "fork argv echo hi", rounds, [&] { forked( echo ); } );
+    run( "spawn argv echo hi", rounds, [&] { util::exec( echo, false ); } );
+}
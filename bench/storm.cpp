@@ -0,0 +1,132 @@
+/*
+ * storm
+ * reconnect storm against the server: all connections of a round come at
+ * once and each sends reg, the time is from the first connect to the
+ * last hostname registered. every round drops all connections first, as
+ * when the server comes back after a restart
+ *
+ * bench/storm [acceptors] [threads] [connections] [rounds] [port], run
+ * from the top of the tree for .config
+ */
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "lib/command.hpp"
+#include "lib/server.hpp"
+
+using boost::asio::ip::tcp;
+
+Editor editor;
+
+// sessions of the server which have sent reg
+static std::size_t registered( network::server_ptr server ) {
+    std::size_t n = 0;
+    for ( auto& c : server->get_clients() ) n += !c->hostname().empty();
+    return n;
+}
+
+int main( int argc, char** argv ) {
+    auto arg = [&]( int i, unsigned d ) {
+        return argc > i ? unsigned( std::atoi( argv[i] ) ) : d;
+    };
+    unsigned    acceptors = std::max( 1u, arg( 1, 4 ) );
+    unsigned    threads   = std::max( 1u, arg( 2, 4 ) );
+    std::size_t n         = arg( 3, 10000 );
+    unsigned    rounds    = arg( 4, 3 );
+    unsigned    port      = arg( 5, 9955 );
+
+    // a socket at each end of every connection, and some to spare
+    rlimit files;
+    getrlimit( RLIMIT_NOFILE, &files );
+    files.rlim_cur = files.rlim_max;
+    setrlimit( RLIMIT_NOFILE, &files );
+    if ( files.rlim_cur != RLIM_INFINITY && 2 * n + 100 > files.rlim_cur ) {
+        n = files.rlim_cur > 100 ? ( files.rlim_cur - 100 ) / 2 : 0;
+        std::printf( "only %zu connections fit in the open files limit\n",
+                     n );
+    }
+
+    std::vector<std::unique_ptr<boost::asio::io_service> > services;
+    std::vector<boost::asio::io_service*>                   listening;
+    for ( unsigned i = 0; i < acceptors; ++i ) {
+        services.emplace_back( new boost::asio::io_service );
+        listening.push_back( services.back().get() );
+    }
+    auto server = std::make_shared<network::Server>(
+        listening, tcp::endpoint( tcp::v4(), port ) );
+    server->start();
+    register_processor( server, NULL, NULL );
+
+    std::vector<std::thread> pool;
+    for ( unsigned i = 0; i < threads; ++i ) {
+        auto io = listening[i % acceptors];
+        pool.emplace_back( [io] { io->run(); } );
+    }
+
+    std::printf( "%u acceptors, %u threads, %zu connections\n", acceptors,
+                 threads, n );
+
+    typedef std::chrono::steady_clock clock;
+
+    tcp::endpoint to( boost::asio::ip::address_v4::loopback(), port );
+    std::vector<network::package_ptr> regs;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        regs.push_back(
+            std::make_shared<network::Package>( "reg$h" + std::to_string( i ) ) );
+    }
+
+    for ( unsigned r = 0; r < rounds; ++r ) {
+        boost::asio::io_service                     io;
+        std::vector<std::unique_ptr<tcp::socket> > sockets;
+        std::size_t                                 failed = 0;
+
+        auto t0 = clock::now();
+        for ( std::size_t i = 0; i < n; ++i ) {
+            sockets.emplace_back( new tcp::socket( io ) );
+            auto s = sockets.back().get();
+            auto p = regs[i];
+            s->async_connect( to, [&failed, s, p](
+                                      boost::system::error_code ec ) {
+                if ( ec ) {
+                    ++failed;
+                    return;
+                }
+                boost::asio::async_write(
+                    *s, boost::asio::buffer( p->data(), p->length() ),
+                    []( boost::system::error_code, std::size_t ) {} );
+            } );
+        }
+        io.run();
+        while ( registered( server ) + failed < n ) usleep( 1000 );
+        auto t1 = clock::now();
+
+        std::printf( "round %u  %8.1f ms  %zu failed\n", r + 1,
+                     std::chrono::duration<double, std::milli>( t1 - t0 )
+                         .count(),
+                     failed );
+
+        // the server sees every connection go before the next round
+        sockets.clear();
+        while ( !server->get_clients().empty() ) usleep( 1000 );
+    }
+
+    // both ends of every connection, the sessions hold most of it
+    rusage used;
+    getrusage( RUSAGE_SELF, &used );
+    std::printf( "peak rss %ld kB, %.1f kB a connection\n", used.ru_maxrss,
+                 n ? double( used.ru_maxrss ) / n : 0.0 );
+
+    // the sessions hold the io_services, there is nothing to tear down
+    std::fflush( stdout );
+    _exit( 0 );
+}
@@ -0,0 +1,54 @@
+/*
+ * words
+ * lookup of build-in words in the perfect hash of words.hpp against the
+ * std::map of names the interpreter used before it
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lib/command.hpp"
+
+Editor editor;
+
+static void nop( Operate::wrapped& ) {}
+
+int main() {
+    std::map<std::string, std::function<void( Operate::wrapped& )> > names;
+    for ( auto& b : builtins ) names[b.name] = &nop;
+
+    // words and literals of a typical script line
+    std::vector<std::string> tokens = {
+        "dup", "size", "0", ">", "if", "->", "COMMAND", "parse", "hostname",
+        "->>", "this", "\\n", "swap", "++", "1", "print_limit", "drop", "else",
+        "exit", "then", "end", "time", "-", "ns", "server"};
+
+    typedef std::chrono::steady_clock clock;
+
+    const int            rounds = 2000000;
+    volatile std::size_t hits   = 0;
+    double               n      = double( rounds ) * tokens.size();
+
+    auto t0 = clock::now();
+    for ( int i = 0; i < rounds; ++i )
+        for ( auto& t : tokens )
+            if ( names.find( t ) != names.end() ) hits = hits + 1;
+    auto t1 = clock::now();
+    for ( int i = 0; i < rounds; ++i )
+        for ( auto& t : tokens ) {
+            Operate::word w;
+            if ( Operate::lookup( t, w ) ) hits = hits + 1;
+        }
+    auto t2 = clock::now();
+
+    std::printf( "std::map      %6.1f ns/token\n",
+                 std::chrono::duration<double, std::nano>( t1 - t0 ).count() /
+                     n );
+    std::printf( "perfect hash  %6.1f ns/token\n",
+                 std::chrono::duration<double, std::nano>( t2 - t1 ).count() /
+                     n );
+}
@@ -7,11 +7,14 @@
 #include "lib/client.cpp"
 #include "lib/command.hpp"
 #include "lib/package.hpp"
+#include "lib/profile.hpp"
 #include "lib/server.hpp"
 #include "lib/util.h"
 
 #include <ncurses.h>
+#include <memory>
 #include <string>
+#include <vector>
 #include "lib/editor.h"
 #include "lib/window.h"
 
@@ -27,6 +30,18 @@ bool svn = true;
 int    max_row, max_col;
 Editor editor;  // for windows info, etc.
 
+/*
+ * dump word stats to stderr on every SIGUSR1
+ */
+static void watch_stats( boost::asio::signal_set& signals ) {
+    signals.async_wait(
+        [&signals]( const boost::system::error_code& error, int ) {
+            if ( error ) return;
+            profile::dump( std::cerr );
+            watch_stats( signals );
+        } );
+}
+
 int main( int argc, char* argv[] ) {
     /* error handler */
     std::set_terminate( util::error_handler );
@@ -59,14 +74,42 @@ int main( int argc, char* argv[] ) {
 
     try {
         if ( role == "server" ) {
-            boost::asio::io_service io_service;
-            tcp::endpoint           endpoint( tcp::v4(), std::atoi( "8888" ) );
-            auto s = std::make_shared<network::Server>( io_service, endpoint );
+            auto setting = [&_conf_remote]( const char* key, unsigned n ) {
+                if ( _conf_remote.exist( "server", key ) )
+                    n = std::stoul( _conf_remote.value( "server", key ) );
+                return n ? n : 1;
+            };
+            unsigned acceptors = setting( "acceptors", 1 );
+            unsigned threads =
+                setting( "threads", std::thread::hardware_concurrency() );
+            if ( threads < acceptors ) threads = acceptors;
+
+            // one io_service for each acceptor, its sessions stay on it
+            std::vector<std::unique_ptr<boost::asio::io_service> > services;
+            std::vector<boost::asio::io_service*> listening;
+            for ( unsigned i = 0; i < acceptors; ++i ) {
+                services.emplace_back( new boost::asio::io_service );
+                listening.push_back( services.back().get() );
+            }
+
+            tcp::endpoint endpoint( tcp::v4(), std::atoi( "8888" ) );
+            auto s = std::make_shared<network::Server>( listening, endpoint );
             s->start();
 
             register_processor( s, NULL, NULL );
 
-            io_service.run();
+            boost::asio::signal_set signals( *listening.front(), SIGUSR1 );
+            watch_stats( signals );
+
+            // sessions keep their own order on a strand, any thread of
+            // their io_service may run any of them
+            std::vector<std::thread> pool;
+            for ( unsigned i = 1; i < threads; ++i ) {
+                auto io = listening[i % acceptors];
+                pool.emplace_back( [io]() { io->run(); } );
+            }
+            listening.front()->run();
+            for ( auto& t : pool ) t.join();
         }
 
         if ( role == "client" ) {
@@ -92,6 +135,9 @@ int main( int argc, char* argv[] ) {
                            "reg$" + client->hostname() ) );
                    } );
 
+            boost::asio::signal_set signals( io_service, SIGUSR1 );
+            watch_stats( signals );
+
             std::thread t( [&io_service]() { io_service.run(); } );
 
             while ( 1 ) sleep( 1 );
@@ -0,0 +1,34 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local std::uint64_t count = 0;
+}
+
+std::uint64_t arena::allocations() {
+    return count;
+}
+
+/*
+ * global operator new
+ * same as the default one, plus counting
+ */
+void* operator new( std::size_t n ) {
+    ++count;
+    for ( ;; ) {
+        if ( void* p = std::malloc( n ? n : 1 ) ) return p;
+        auto handler = std::get_new_handler();
+        if ( !handler ) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete( void* p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept {
+    std::free( p );
+}
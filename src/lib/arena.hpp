@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/container/pmr/global_resource.hpp>
+#include <boost/container/pmr/monotonic_buffer_resource.hpp>
+#include <boost/container/pmr/unsynchronized_pool_resource.hpp>
+
+namespace arena {
+
+typedef boost::container::pmr::memory_resource resource;
+
+/*
+ * allocations
+ * heap allocations made by the calling thread so far, counted by the
+ * global operator new (see arena.cpp)
+ */
+std::uint64_t allocations();
+
+/*
+ * counted
+ * heap memory behind a request, keeps the number of bytes it holds
+ */
+class counted : public resource {
+   public:
+    std::size_t bytes() const {
+        return _bytes;
+    }
+
+   private:
+    void* do_allocate( std::size_t n, std::size_t align ) override {
+        auto p = heap()->allocate( n, align );
+        _bytes += n;
+        return p;
+    }
+
+    void do_deallocate( void* p, std::size_t n, std::size_t align ) override {
+        _bytes -= n;
+        heap()->deallocate( p, n, align );
+    }
+
+    bool do_is_equal( const resource& other ) const noexcept override {
+        return this == &other;
+    }
+
+    static resource* heap() {
+        return boost::container::pmr::new_delete_resource();
+    }
+
+    std::size_t _bytes = 0;
+};
+
+/*
+ * request
+ * memory for one interpreter call, given back all at once when the
+ * request ends. the first block is kept per thread and per nesting level,
+ * so a request fitting in it never reaches the heap. freed memory goes to
+ * pools for reuse, a long loop inside one request does not pile up
+ */
+class request {
+   public:
+    enum { block_size = 64 * 1024 };
+
+    request()
+        : _level( level()++ ),
+          _monotonic( block( _level ), block_size, &_upstream ),
+          _pool( &_monotonic ) {}
+
+    ~request() {
+        --level();
+    }
+
+    request( const request& ) = delete;
+    request& operator=( const request& ) = delete;
+
+    resource* get() {
+        return &_pool;
+    }
+
+    // bytes of memory the request holds, its first block included
+    std::size_t used() const {
+        return block_size + _upstream.bytes();
+    }
+
+   private:
+    static std::size_t& level() {
+        static thread_local std::size_t n = 0;
+        return n;
+    }
+
+    static void* block( std::size_t i ) {
+        static thread_local std::vector<std::unique_ptr<char[]>> blocks;
+        while ( blocks.size() <= i ) {
+            blocks.emplace_back( new char[block_size] );
+        }
+        return blocks[i].get();
+    }
+
+    std::size_t                                         _level;
+    counted                                             _upstream;
+    boost::container::pmr::monotonic_buffer_resource    _monotonic;
+    boost::container::pmr::unsynchronized_pool_resource _pool;
+};
+}
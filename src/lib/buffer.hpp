@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <boost/utility/string_view.hpp>
+
+namespace bytecode {
+
+/*
+ * buffer
+ * text with free room at both ends, so that the only owner of a buffer can
+ * append and prepend in place. when the room runs out the text moves to a
+ * new buffer twice its size, half of the room at each end, which makes a
+ * loop of "++" amortized O(1) whichever side it grows
+ *
+ * a buffer held by more than one value is never written, see value
+ *
+ * bytes of the buffers are kept per thread, see held
+ */
+class buffer {
+   public:
+    typedef std::shared_ptr<buffer> pointer;
+
+    // take over a string, no copy
+    explicit buffer( std::string&& s )
+        : _bytes( std::move( s ) ), _begin( 0 ), _end( _bytes.size() ) {
+        held() += _bytes.size();
+    }
+
+    buffer( boost::string_view s, std::size_t front, std::size_t back )
+        : _bytes( front + s.size() + back, '\0' ),
+          _begin( front ),
+          _end( front + s.size() ) {
+        if ( !s.empty() ) std::memcpy( &_bytes[_begin], s.data(), s.size() );
+        held() += _bytes.size();
+    }
+
+    ~buffer() {
+        held() -= _bytes.size();
+    }
+
+    buffer( const buffer& ) = delete;
+    buffer& operator=( const buffer& ) = delete;
+
+    /*
+     * held
+     * bytes of buffers made by this thread less those it freed, a buffer
+     * freed by another thread is taken off there
+     */
+    static std::int64_t& held() {
+        static thread_local std::int64_t n = 0;
+        return n;
+    }
+
+    const char* data() const {
+        return _bytes.data() + _begin;
+    }
+
+    std::size_t size() const {
+        return _end - _begin;
+    }
+
+    boost::string_view view() const {
+        return boost::string_view( data(), size() );
+    }
+
+    bool append( boost::string_view s ) {
+        if ( _bytes.size() - _end < s.size() ) return false;
+        if ( !s.empty() ) std::memcpy( &_bytes[_end], s.data(), s.size() );
+        _end += s.size();
+        return true;
+    }
+
+    bool prepend( boost::string_view s ) {
+        if ( _begin < s.size() ) return false;
+        _begin -= s.size();
+        if ( !s.empty() ) std::memcpy( &_bytes[_begin], s.data(), s.size() );
+        return true;
+    }
+
+    /*
+     * concat
+     * new buffer holding a + b with room to grow
+     */
+    static pointer concat( boost::string_view a, boost::string_view b ) {
+        auto total = a.size() + b.size();
+        auto room  = total / 2 + 16;
+        auto p     = std::make_shared<buffer>( a, room, b.size() + room );
+        p->append( b );
+        return p;
+    }
+
+   private:
+    std::string _bytes;
+    std::size_t _begin, _end;
+};
+}
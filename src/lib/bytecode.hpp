@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/container/pmr/polymorphic_allocator.hpp>
+#include <boost/container/pmr/vector.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "value.hpp"
+
+namespace bytecode {
+
+/*
+ * opcodes
+ * every token of a line compiles to exactly one instruction, so the text of
+ * the remaining program can always be recovered (see program::remaining)
+ */
+enum opcode : std::uint8_t {
+    PUSH,   // push literal into vstack
+    CALL,   // call build-in word
+    BEGIN,  // loop head, no-op
+    END,    // jump back to loop body
+    IF,     // pop condition, jump to else part when "0"
+    ELSE,   // end of true part, jump after then
+    THEN,   // no-op
+    EXIT,   // jump after the innermost loop
+    DEFINE  // ";" of a colon definition, define the word and jump after ":"
+};
+
+static const std::uint32_t npos = static_cast<std::uint32_t>( -1 );
+
+typedef boost::container::pmr::memory_resource resource;
+
+using boost::container::allocator_arg;
+
+/*
+ * instruction
+ * the literal is constructed in the memory of the program holding it
+ */
+template <typename Word>
+struct instruction {
+    typedef value::allocator_type allocator_type;
+
+    instruction() = default;
+    instruction( value::allocator_arg_t, const allocator_type& a )
+        : data( boost::container::allocator_arg, a ) {}
+    instruction( value::allocator_arg_t, const allocator_type& a,
+                 const instruction& i )
+        : op( i.op ),
+          jump( i.jump ),
+          close( i.close ),
+          leave( i.leave ),
+          word( i.word ),
+          data( boost::container::allocator_arg, a, i.data ) {}
+    instruction( value::allocator_arg_t, const allocator_type& a,
+                 instruction&& i )
+        : op( i.op ),
+          jump( i.jump ),
+          close( i.close ),
+          leave( i.leave ),
+          word( i.word ),
+          data( boost::container::allocator_arg, a, std::move( i.data ) ) {}
+
+    opcode        op    = PUSH;
+    std::uint32_t jump  = npos;  // branch target of END / IF / ELSE
+    std::uint32_t close = npos;  // matching end / then of BEGIN / IF
+    std::uint32_t leave = npos;  // first instruction after innermost loop
+    Word          word  = Word();
+    value         data;  // literal, or the token itself
+};
+
+template <typename Word>
+class program {
+   public:
+    explicit program( resource* r ) : code( r ) {}
+
+    /*
+     * compile
+     * argv is in line order, i.e. the last token runs first
+     * resolve( token, word ) tells whether token is a word
+     * the program and its literals are allocated from r
+     */
+    template <typename Tokens, typename Resolver>
+    static std::shared_ptr<const program> compile(
+        const Tokens& argv, const Resolver& resolve,
+        resource* r = boost::container::pmr::get_default_resource() ) {
+        auto p = std::allocate_shared<program>(
+            boost::container::pmr::polymorphic_allocator<program>( r ), r );
+        auto& code = p->code;
+        auto  n    = static_cast<std::uint32_t>( argv.size() );
+        code.resize( n );
+
+        boost::container::pmr::vector<std::uint32_t> loops( r ), conds( r ),
+            scope( n, npos, r ), colon( n, npos, r );
+
+        // ": name ... ;" in line order, not nested, ";" runs first
+        std::uint32_t open = npos, k = 0;
+        for ( auto it = argv.begin(); it != argv.end(); ++it, ++k ) {
+            auto token = boost::string_view( *it );
+            if ( token == ":" && open == npos ) {
+                open = k;
+            } else if ( token == ";" && open != npos && k >= open + 2 ) {
+                colon[n - 1 - k] = n - 1 - open;
+                open             = npos;
+            }
+        }
+        std::uint32_t body_end = npos;
+
+        std::uint32_t i = 0;
+        for ( auto it = argv.rbegin(); it != argv.rend(); ++it, ++i ) {
+            auto& ins   = code[i];
+            auto  token = boost::string_view( *it );
+            scope[i]    = loops.empty() ? npos : loops.back();
+
+            if ( body_end != npos && i <= body_end ) {
+                // name and body of a definition, kept as they are
+                ins.op = PUSH;
+                if ( i == body_end ) body_end = npos;
+            } else if ( colon[i] != npos ) {
+                ins.op    = DEFINE;
+                ins.close = colon[i];
+                ins.jump  = colon[i] + 1;
+                body_end  = colon[i];
+            } else if ( token == "begin" ) {
+                ins.op = BEGIN;
+                loops.push_back( i );
+            } else if ( token == "end" && !loops.empty() ) {
+                ins.op   = END;
+                ins.jump = loops.back() + 1;
+                code[loops.back()].close = i;
+                loops.pop_back();
+            } else if ( token == "if" ) {
+                ins.op = IF;
+                conds.push_back( i );
+            } else if ( token == "else" && !conds.empty() ) {
+                auto& head = code[conds.back()];
+                // a second else of the same if is dropped, like a then
+                ins.op = head.jump == npos ? ELSE : THEN;
+                if ( ins.op == ELSE ) head.jump = i + 1;
+            } else if ( token == "then" && !conds.empty() ) {
+                auto& head = code[conds.back()];
+                ins.op     = THEN;
+                head.close = i;
+                if ( head.jump == npos )
+                    head.jump = i + 1;
+                else
+                    code[head.jump - 1].jump = i + 1;
+                conds.pop_back();
+            } else if ( token == "exit" ) {
+                ins.op = EXIT;
+            } else {
+                ins.op = resolve( token, ins.word ) ? CALL : PUSH;
+            }
+            ins.data = ins.op == PUSH ? value::literal( token, r )
+                                      : value( allocator_arg, r, token );
+        }
+
+        // unmatched begin is a no-op, unmatched if runs to the end
+        for ( auto l : loops ) code[l].close = n - 1;
+        for ( auto c : conds ) {
+            auto& head = code[c];
+            head.close = n - 1;
+            if ( head.jump == npos )
+                head.jump = n;
+            else
+                code[head.jump - 1].jump = n;
+        }
+
+        for ( i = 0; i < n; ++i ) {
+            auto l = scope[i];
+            if ( l != npos ) {
+                code[i].leave = code[l].close + 1;
+            }
+        }
+
+        return p;
+    }
+
+    std::size_t size() const {
+        return code.size();
+    }
+
+    const instruction<Word>& operator[]( std::size_t i ) const {
+        return code[i];
+    }
+
+    /*
+     * remaining
+     * append tokens of the program left from pc in execution order,
+     * the same tokens the old call stack would have held at this point
+     */
+    void remaining( std::size_t pc, std::vector<std::string>& out ) const {
+        auto i = pc;
+        while ( i < code.size() ) {
+            auto& ins = code[i];
+            switch ( ins.op ) {
+                case BEGIN:
+                case IF:
+                case DEFINE:
+                    // not entered yet, copy as it is
+                    verbatim( i, ins.close, out );
+                    i = ins.close + 1;
+                    break;
+                case END:
+                    // inside of a loop, the old call stack held one more
+                    // round of the loop after current one
+                    out.push_back( "begin" );
+                    verbatim( ins.jump, i, out );
+                    ++i;
+                    break;
+                case ELSE:
+                    // inside of true part, else part has been dropped
+                    i = ins.jump;
+                    break;
+                case THEN:
+                    ++i;
+                    break;
+                default:
+                    out.push_back( ins.data.str() );
+                    ++i;
+            }
+        }
+    }
+
+   private:
+    void verbatim( std::size_t from, std::size_t to,
+                   std::vector<std::string>& out ) const {
+        for ( auto i = from; i <= to && i < code.size(); ++i ) {
+            out.push_back( code[i].data.str() );
+        }
+    }
+
+    boost::container::pmr::vector<instruction<Word>> code;
+};
+
+/*
+ * frame
+ * compiled program and its program counter
+ */
+template <typename Word>
+struct frame {
+    std::shared_ptr<const program<Word>> code;
+    std::size_t                          pc;
+};
+}
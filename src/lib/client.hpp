@@ -13,7 +13,9 @@
 #include <string>
 #include <vector>
 
+#include "frames.hpp"
 #include "package.hpp"
+#include "slot.hpp"
 
 namespace network {
 
@@ -38,6 +40,26 @@ class _Client {
 
     virtual std::string hostname()                  = 0;
     virtual void        set_hostname( std::string ) = 0;
+
+    // run f on the network thread
+    virtual void post( std::function<void()> f ) {
+        f();
+    }
+
+    /*
+     * drained
+     * on the network thread, f( true ) once fewer than Package::high_water
+     * bytes wait to be sent, f( false ) when the link is lost
+     */
+    virtual void drained( std::function<void( bool )> f ) {
+        f( true );
+    }
+
+    // words defined by the lines run on this agent
+    slot words;
+
+    // order of the results of the commands it runs
+    slot commands;
 };
 
 typedef std::shared_ptr<_Client> client_ptr;
@@ -65,12 +87,26 @@ class Client : public _Client, public std::enable_shared_from_this<Client> {
         _io_service.post( [this, msg]() {
             bool write_in_progress = !send_queue.empty();
             send_queue.push_back( msg );
+            queued += msg->length();
             if ( !write_in_progress ) {
                 write();
             }
         } );
     };
 
+    void post( std::function<void()> f ) {
+        _io_service.post( std::move( f ) );
+    }
+
+    void drained( std::function<void( bool )> f ) {
+        if ( lost )
+            f( false );
+        else if ( queued < Package::high_water )
+            f( true );
+        else
+            waiting.push_back( f );
+    }
+
     void on( string event, std::function<void( package_ptr, client_ptr )> fn ) {
         _el.push_back( make_pair( event, fn ) );
     };
@@ -97,7 +133,7 @@ class Client : public _Client, public std::enable_shared_from_this<Client> {
             _socket, endpoint_iterator,
             [this]( boost::system::error_code ec, tcp::resolver::iterator ) {
                 if ( !ec ) {
-                    read_header();
+                    read();
                     apply( "connect", NULL );
                 } else {
                     std::cout << "\nError: " << ec.message() << "\n";
@@ -106,63 +142,82 @@ class Client : public _Client, public std::enable_shared_from_this<Client> {
             } );
     }
 
-    void read_header() {
+    // as much as the socket has, then every package complete in it
+    void read() {
         auto self( shared_from_this() );
-        recv_package = std::make_shared<Package>();
-        boost::asio::async_read(
-            _socket,
-            boost::asio::buffer( recv_package->data(), Package::header_len() ),
-            [this, self]( boost::system::error_code ec,
-                          std::size_t /*length*/ ) {
-                if ( !ec && recv_package->decrypt() ) {
-                    read_body();
-                } else {
-                    close();
-                }
+        _socket.async_read_some(
+            _frames.space(),
+            [this, self]( boost::system::error_code ec, std::size_t len ) {
+                if ( ec ) return fail();
+                _frames.filled( len );
+                take();
             } );
     }
 
-    void read_body() {
+    void take() {
+        while ( auto package = _frames.next() )
+            apply( "recv_package", package );
+        if ( _frames.broken() ) return fail();
+        if ( !_frames.straight() ) return read();
+
         auto self( shared_from_this() );
         boost::asio::async_read(
-            _socket, boost::asio::buffer( recv_package->body(),
-                                          recv_package->body_length() ),
+            _socket, _frames.rest(),
             [this, self]( boost::system::error_code ec, std::size_t len ) {
-                if ( !ec ) {
-                    this->apply( "recv_package", recv_package );
-                    read_header();
-                } else {
-                    apply( "link_lost", NULL );
-                    close();
-                }
+                auto package = _frames.finish();
+                if ( ec ) return fail( true );
+                apply( "recv_package", package );
+                read();
             } );
-    };
+    }
+
+    // a link lost within a package is told to link_lost
+    void fail( bool within = false ) {
+        lost = true;
+        release();
+        if ( within || _frames.partial() ) apply( "link_lost", NULL );
+        close();
+    }
 
+    // every package waiting, up to gather::max_bytes, in one call
     void write() {
-        send_queue.front()->encrypt();
         boost::asio::async_write(
-            _socket, boost::asio::buffer( send_queue.front()->data(),
-                                          send_queue.front()->length() ),
+            _socket, _gather.take( send_queue ), &gather::counted,
             [this]( boost::system::error_code ec, std::size_t ) {
                 if ( !ec ) {
-                    send_queue.pop_front();
+                    queued -= _gather.bytes();
+                    send_queue.erase(
+                        send_queue.begin(),
+                        send_queue.begin() + _gather.packages() );
+                    if ( queued < Package::high_water ) release();
                     if ( !send_queue.empty() ) {
                         write();
                     }
                 } else {
-                    apply( "link_lost", NULL );
-                    close();
+                    fail( true );
                 }
             } );
     };
 
+    // run the callbacks waiting in drained
+    void release() {
+        auto w = std::move( waiting );
+        waiting.clear();
+        for ( auto& f : w ) f( !lost );
+    }
+
     boost::asio::io_service& _io_service;
     tcp::socket              _socket;
 
     deque<package_ptr> send_queue;
+    std::size_t        queued = 0;  // bytes in send_queue
+    bool               lost   = false;
+
+    vector<std::function<void( bool )> > waiting;
 
     vector<pair<string, std::function<void( package_ptr, client_ptr )> > > _el;
 
-    package_ptr recv_package;
+    frames _frames;
+    gather _gather;
 };
 }
@@ -2,26 +2,48 @@
 #define __COMMAND__
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/any.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/functional/hash.hpp>
+#include <deque>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <regex>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/container/pmr/deque.hpp>
+#include <boost/container/pmr/vector.hpp>
+
+#include "arena.hpp"
+#include "bytecode.hpp"
 #include "client.hpp"
 #include "config.h"
+#include "metrics.hpp"
 #include "package.hpp"
+#include "pattern.hpp"
+#include "profile.hpp"
+#include "reduce.hpp"
+#include "script.hpp"
 #include "server.hpp"
 #include "util.h"
+#include "wire.hpp"
+#include "words.hpp"
 
 #include "editor.h"
 
@@ -29,6 +51,7 @@ using std::vector;
 using std::string;
 using std::cout;
 using std::endl;
+using bytecode::value;
 
 namespace fs = boost::filesystem;
 
@@ -68,59 +91,378 @@ static std::string script_dir( "" );
 
 class Operate {
    public:
+    struct wrapped;
+
+    struct definition;
+
+    typedef std::function<void( wrapped& )> fn;
+
+    /*
+     * word
+     * build-in word is called directly, word registered at runtime goes
+     * through fn_map, word defined by ": name ... ;" runs its program
+     */
+    struct word {
+        void ( *native )( wrapped& ) = nullptr;
+        const fn*         runtime    = nullptr;
+        const definition* defined    = nullptr;
+        profile::id       id         = 0;
+
+        // false when a defined word has no program yet
+        bool operator()( wrapped& w ) const;
+    };
+
+    typedef bytecode::program<word> program;
+    typedef bytecode::frame<word>   frame;
+
+    /*
+     * definition
+     * body of ": name ... ;", compiled once when the definition runs.
+     * entries are never removed, so words may point to them, defining the
+     * name again swaps the program
+     */
+    struct definition {
+        std::shared_ptr<const program> code;
+    };
+
+    /*
+     * dictionary
+     * words defined by ": name ... ;" in the lines of one link, a session
+     * of the server or the client of an agent, so no peer defines words
+     * for the lines of another. the workers of a prun may use it at once
+     */
+    class dictionary {
+       public:
+        enum { max = 4096 };
+
+        /*
+         * declare
+         * entry of name, created when missing. nullptr once max names are
+         * held, entries are never removed
+         */
+        definition* declare( boost::string_view name ) {
+            std::lock_guard<std::mutex> lock( _mutex );
+            auto                        names = std::atomic_load( &_names );
+            auto                        it    = names->find( name );
+            if ( it != names->end() ) return it->second;
+            if ( _definitions.size() >= max ) return nullptr;
+
+            // readers go on with the old index, see find
+            _definitions.emplace_back();
+            auto next = std::make_shared<index>( *names );
+            next->emplace( name.to_string(), &_definitions.back() );
+            std::atomic_store( &_names,
+                               std::shared_ptr<const index>( next ) );
+            _size.store( _definitions.size() );
+            return &_definitions.back();
+        }
+
+        const definition* find( boost::string_view name ) const {
+            // most literals are looked up while nothing is defined at all
+            if ( !_size.load( std::memory_order_relaxed ) ) return nullptr;
+            auto names = std::atomic_load( &_names );
+            auto it    = names->find( name );
+            return it == names->end() ? nullptr : it->second;
+        }
+
+        // of the link of a call, a call on no link has the local one
+        static std::shared_ptr<dictionary> of( network::session_ptr session,
+                                               network::client_ptr  client ) {
+            if ( session ) return session->words.get<dictionary>();
+            if ( client ) return client->words.get<dictionary>();
+            static auto local = std::make_shared<dictionary>();
+            return local;
+        }
+
+       private:
+        // copied on every new name, definitions stay where they are
+        typedef std::map<std::string, definition*, std::less<>> index;
+
+        std::shared_ptr<const index> _names = std::make_shared<index>();
+        std::deque<definition>       _definitions;
+        std::atomic<std::size_t>     _size{0};
+        std::mutex                   _mutex;
+    };
+
+    /*
+     * budget
+     * limits of one process call, 0 for no limit. steps counts the
+     * instructions run, bytes the memory held by the stacks: the arena of
+     * the call and the long text made during it (see buffer::held)
+     */
+    struct budget {
+        std::uint64_t steps;
+        std::uint64_t bytes;
+    };
+
+    static budget limits;
+
     /*
      * Wrapped object
      * including call stack, variable stack, output stack,
      * package, shared pointer to server / client / editor
      */
     struct wrapped {
-        wrapped( std::deque<std::string> _astack,
-                 std::deque<std::string> _vstack, network::package_ptr _package,
+        wrapped( arena::request& _memory, network::package_ptr _package,
                  network::session_ptr _session, network::server_ptr _server,
                  network::client_ptr _client, Editor* _editor )
-            : astack( _astack ),
-              vstack( _vstack ),
-              ostack(),
+            : astack( _memory.get() ),
+              vstack( _memory.get() ),
+              ostack( _memory.get() ),
               package( _package ),
               session( _session ),
               server( _server ),
               client( _client ),
-              editor( _editor ){};
-
-        std::deque<std::string> astack;
-        std::deque<std::string> vstack;
-        std::deque<std::string> ostack;
+              editor( _editor ),
+              words( dictionary::of( _session, _client ) ),
+              memory( &_memory ),
+              held( bytecode::buffer::held() ){};
+
+        boost::container::pmr::vector<frame> astack;
+        boost::container::pmr::deque<value>  vstack;
+        boost::container::pmr::deque<value>  ostack;
         network::package_ptr    package;
         network::session_ptr    session;
         network::server_ptr     server;
         network::client_ptr     client;
         Editor*                 editor;
+
+        std::shared_ptr<dictionary> words;
+        arena::request*             memory;
+        std::int64_t    held;       // buffer::held() when the call began
+        std::uint64_t   steps = 0;  // instructions run
+        budget          limit = limits;
+
+        std::uint64_t used() const {
+            auto made = bytecode::buffer::held() - held;
+            return memory->used() + ( made > 0 ? made : 0 );
+        }
     };
 
+    /*
+     * compile
+     * turn a line into instructions, resolving build-in words, the words
+     * of the dictionary and jumps
+     */
+    template <typename Tokens>
+    static std::shared_ptr<const program> compile( const Tokens&    argv,
+                                                   dictionary&      words,
+                                                   arena::resource* memory ) {
+        // a word defined in this line can be called after its definition,
+        // names are taken from ": name ... ;" paired as program::compile
+        // pairs them, never from a lone ":"
+        std::size_t open = argv.size();
+        for ( std::size_t k = 0; k < argv.size(); ++k ) {
+            auto token = boost::string_view( argv[k] );
+            if ( token == ":" && open == argv.size() ) {
+                open = k;
+            } else if ( token == ";" && open != argv.size() && k >= open + 2 ) {
+                words.declare( argv[open + 1] );
+                open = argv.size();
+            }
+        }
+        auto resolve = [&words]( boost::string_view token, word& w ) {
+            return lookup( token, w, &words );
+        };
+        return program::compile( argv, resolve, memory );
+    }
+
+    /*
+     * lookup
+     * find word by name, build-in words first, then those of words
+     */
+    static bool lookup( boost::string_view token, word& w,
+                        const dictionary* words = nullptr );
+
+    /*
+     * define
+     * register a word at runtime
+     */
+    static void define( const std::string& name, fn f ) {
+        fn_map[name] = f;
+    }
+
+    /*
+     * colon
+     * DEFINE at pc of p, compile the body in between ";" and ":" once and
+     * keep it under the name
+     */
+    static void colon( wrapped& w, const program& p, std::size_t pc ) {
+        auto                     close = p[pc].close;
+        std::vector<std::string> body;
+        for ( auto i = close - 1; i-- > pc + 1; ) {
+            body.push_back( p[i].data.str() );
+        }
+        auto d = w.words->declare( p[close - 1].data.str() );
+        if ( !d ) {
+            w.vstack.push_back( "error: dictionary full, " +
+                                std::to_string( dictionary::max ) + " words" );
+            return;
+        }
+        std::atomic_store(
+            &d->code, compile( body, *w.words,
+                               boost::container::pmr::get_default_resource() ) );
+    }
+
+    /*
+     * call
+     * push a line onto call stack, it runs before the remaining part
+     */
+    template <typename Tokens>
+    static void call( wrapped& w, const Tokens& argv ) {
+        w.astack.push_back(
+            frame{compile( argv, *w.words, w.astack.get_allocator().resource() ),
+                  0} );
+    }
+
     /*
      * next
      * process call stack sequently
      */
     static void next( wrapped& w ) {
         while ( !w.astack.empty() ) {
-            if ( fn_map.find( w.astack.back() ) == fn_map.end() ) {
-                w.vstack.push_back( w.astack.back() );
+            auto& f = w.astack.back();
+            if ( f.pc >= f.code->size() ) {
                 w.astack.pop_back();
-            } else {
-                auto command = w.astack.back();
-                w.astack.pop_back();
-                fn_map[command]( w );
+                continue;
+            }
+            if ( over_budget( w ) ) return;
+            auto& ins = ( *f.code )[f.pc++];
+            switch ( ins.op ) {
+                case bytecode::PUSH:
+                    w.vstack.push_back( ins.data );
+                    break;
+                case bytecode::CALL: {
+                    // the word may drop the frame and ins with it
+                    auto id      = ins.word.id;
+                    auto started = profile::start();
+                    if ( ins.word( w ) )
+                        profile::record( id, started );
+                    else
+                        w.vstack.push_back( ins.data );
+                    break;
+                }
+                case bytecode::END:
+                case bytecode::ELSE:
+                    f.pc = ins.jump;
+                    break;
+                case bytecode::IF: {
+                    auto cond = w.vstack.back().truth();
+                    w.vstack.pop_back();
+                    if ( !cond ) f.pc = ins.jump;
+                    break;
+                }
+                case bytecode::EXIT:
+                    exit( w );
+                    break;
+                case bytecode::DEFINE:
+                    colon( w, *f.code, f.pc - 1 );
+                    f.pc = ins.jump;
+                    break;
+                default:
+                    break;
             }
         }
     };
 
+    /*
+     * over_budget
+     * count one step, when a limit is passed the call is dropped and the
+     * error goes back to where the call came from
+     */
+    static bool over_budget( wrapped& w ) {
+        auto steps = w.limit.steps && ++w.steps > w.limit.steps;
+        if ( !steps && !( w.limit.bytes && w.used() > w.limit.bytes ) )
+            return false;
+
+        auto what = steps ? std::to_string( w.limit.steps ) + " steps"
+                          : std::to_string( w.limit.bytes ) + " bytes";
+
+        w.astack.clear();
+        w.vstack.clear();
+        w.ostack.clear();
+        w.vstack.push_back( "error: budget of " + what + " exceeded" );
+        if ( w.package && ( w.session || w.client ) ) {
+            call( w, util::views{"print"} );
+            auto p = _pack_stack( w );
+            w.astack.clear();
+            if ( w.session )
+                w.session->send( p );
+            else
+                w.client->send( p );
+        } else {
+            print( w );
+        }
+        return true;
+    }
+
+    /*
+     * left
+     * budget of a call made from w, what w has not used yet split into
+     * share parts. 0 stays no limit, and a spent limit leaves 1 so the
+     * call stops at its first step
+     */
+    static budget left( const wrapped& w, std::size_t share = 1 ) {
+        return split( w.limit, w.steps, w.used(), share );
+    }
+
+    // limit less the steps and bytes used, split into share parts
+    static budget split( budget limit, std::uint64_t steps,
+                         std::uint64_t bytes, std::size_t share ) {
+        auto part = [share]( std::uint64_t limit, std::uint64_t used ) {
+            if ( !limit ) return std::uint64_t( 0 );
+            return std::max<std::uint64_t>(
+                1, ( limit > used ? limit - used : 0 ) / share );
+        };
+        return budget{part( limit.steps, steps ), part( limit.bytes, bytes )};
+    }
+
+    /*
+     * spent
+     * true once the steps of w, with those of its nested calls, are used
+     * up. the nested call that ran out has sent the error already
+     */
+    static bool spent( const wrapped& w ) {
+        return w.limit.steps && w.steps >= w.limit.steps;
+    }
+
+    /*
+     * exit
+     * break from the innermost loop, which may be in an outer frame
+     * when exit comes from parse
+     */
+    static void exit( wrapped& w ) {
+        while ( !w.astack.empty() ) {
+            auto& f     = w.astack.back();
+            auto  leave = ( *f.code )[f.pc - 1].leave;
+            if ( leave != bytecode::npos ) {
+                f.pc = leave;
+                return;
+            }
+            w.astack.pop_back();
+        }
+    }
+
+    /*
+     * remaining
+     * tokens of the call stack in line order
+     */
+    static std::vector<std::string> remaining( wrapped& w ) {
+        std::vector<std::string> rest;
+        for ( auto it = w.astack.rbegin(); it != w.astack.rend(); ++it ) {
+            it->code->remaining( it->pc, rest );
+        }
+        std::reverse( rest.begin(), rest.end() );
+        return rest;
+    }
+
     /*
      * _const
      * replace const variable and this
      * special for scope operator
+     * self keeps the hostname the replaced tokens point to
      */
-    static void _const( std::vector<std::string>& argv, network::package_ptr,
-                        network::session_ptr, network::server_ptr,
+    static void _const( util::views& argv, std::string& self,
                         network::client_ptr client ) {
         int level = 0;
         for ( auto it = argv.begin(); it != argv.end(); ++it ) {
@@ -131,7 +473,8 @@ class Operate {
                 --level;
                 if ( level == 0 ) it = argv.erase( it );
             } else if ( *it == "this" && !level ) {
-                *it = client->hostname();
+                if ( self.empty() ) self = client->hostname();
+                *it = self;
             }
             if ( it == argv.end() ) break;
         }
@@ -139,24 +482,81 @@ class Operate {
 
     /*
      * process
-     * interpret a line of code
-     */
-    static std::deque<std::string> process( std::string          line,
-                                            network::package_ptr package,
-                                            network::session_ptr session,
-                                            network::server_ptr  server,
-                                            network::client_ptr  client,
-                                            Editor*              editor ) {
-        auto argv = util::split( line, '$' );
-        _const( argv, package, session, server, client );
-        wrapped w( std::deque<std::string>(), std::deque<std::string>(),
-                   package, session, server, client, editor );
-        for ( auto arg : argv ) {
-            w.astack.push_back( arg );
+     * interpret a line of code, tokens are views into line until compiled
+     */
+    static std::vector<value> process( boost::string_view   line,
+                                       network::package_ptr package,
+                                       network::session_ptr session,
+                                       network::server_ptr  server,
+                                       network::client_ptr  client,
+                                       Editor*              editor ) {
+        util::views argv;
+        util::split_view( line, '$', argv );
+        return process( argv, package, session, server, client, editor );
+    }
+
+    /*
+     * process
+     * interpret tokens of a line
+     */
+    static std::vector<value> process(
+        const std::vector<std::string>& tokens, network::package_ptr package,
+        network::session_ptr session, network::server_ptr server,
+        network::client_ptr client, Editor* editor, budget limit = limits,
+        std::uint64_t* steps = nullptr ) {
+        util::views argv( tokens.begin(), tokens.end() );
+        return process( argv, package, session, server, client, editor, limit,
+                        steps );
+    }
+
+    /*
+     * process
+     * all state of the call lives in one arena, the output is copied out.
+     * a call nested in another runs within what the outer one has left,
+     * and tells the steps it ran
+     */
+    static std::vector<value> process( util::views&         argv,
+                                       network::package_ptr package,
+                                       network::session_ptr session,
+                                       network::server_ptr  server,
+                                       network::client_ptr  client,
+                                       Editor*              editor,
+                                       budget               limit = limits,
+                                       std::uint64_t*       steps = nullptr ) {
+        arena::request memory;
+        wrapped        w( memory, package, session, server, client, editor );
+        w.limit  = limit;
+        auto out = execute( w, argv );
+        if ( steps ) *steps = w.steps;
+        return out;
+    };
+
+    /*
+     * process_stack
+     * interpret a call stack and vstack received in binary form
+     */
+    static std::vector<value> process_stack( boost::string_view   data,
+                                             network::package_ptr package,
+                                             network::session_ptr session,
+                                             network::server_ptr  server,
+                                             network::client_ptr  client,
+                                             Editor*              editor ) {
+        arena::request memory;
+        wrapped        w( memory, package, session, server, client, editor );
+        util::views    argv;
+        if ( !wire::decode( data, argv, w.vstack ) ) {
+            return std::vector<value>();
         }
+        return execute( w, argv );
+    }
+
+    static std::vector<value> execute( wrapped& w, util::views& argv ) {
+        std::string self;
+        _const( argv, self, w.client );
+        call( w, argv );
         next( w );
-        return w.ostack;
-    };
+        return std::vector<value>( w.ostack.begin(), w.ostack.end() );
+    }
 
     /*
      * output operator (*)
@@ -170,19 +570,37 @@ class Operate {
     /*
      * _pack
      * helper function for packing all the stacks into one string
+     * text form, vstack from the top down after the call stack. a '$' is
+     * only put between two parts when what is packed before it is not empty
      */
     static std::string _pack( wrapped& w ) {
-        auto vp = std::accumulate(
-            w.vstack.begin(), w.vstack.end(), string( "" ),
-            [&]( const string& s1, const string& s2 ) -> string {
-                return s1.empty() ? s2 : s2 + "$" + s1;
-            } );
-        auto ap = std::accumulate(
-            w.astack.begin(), w.astack.end(), string( "" ),
-            [&]( const string& s1, const string& s2 ) -> string {
-                return s1.empty() ? s2 : s1 + "$" + s2;
-            } );
-        return ap + ( vp == "" ? "" : "$" ) + vp;
+        std::string p;
+        for ( auto& token : remaining( w ) ) {
+            if ( !p.empty() ) p += '$';
+            p += token;
+        }
+
+        // values below the lowest non-empty one leave no trace
+        std::size_t low = 0, n = w.vstack.size();
+        while ( low < n && w.vstack[low].view().empty() &&
+                !w.vstack[low].is_number() )
+            ++low;
+        if ( low < n ) p += '$';
+        for ( auto i = n; i-- > low; ) {
+            w.vstack[i].write( p );
+            if ( i > low ) p += '$';
+        }
+        return p;
+    }
+
+    /*
+     * _pack_stack
+     * binary form of the stacks for the wire, see wire.hpp
+     */
+    static network::package_ptr _pack_stack( wrapped& w ) {
+        return std::make_shared<network::Package>(
+            wire::encode( remaining( w ), w.vstack ),
+            network::Package::_STACK );
     }
 
     /*
@@ -198,7 +616,7 @@ class Operate {
      * lower command
      */
     static void lwc( wrapped& w ) {
-        auto s = w.vstack.back();
+        auto s = w.vstack.back().str();
         boost::algorithm::to_lower( s );
         w.vstack.pop_back();
         w.vstack.push_back( s );
@@ -209,7 +627,7 @@ class Operate {
      * upper command
      */
     static void upc( wrapped& w ) {
-        std::string s = w.vstack.back();
+        std::string s = w.vstack.back().str();
         std::transform( s.begin(), s.end(), s.begin(),
                         []( unsigned char c ) { return std::toupper( c ); } );
         w.vstack.pop_back();
@@ -218,20 +636,72 @@ class Operate {
 
     /*
      * split
-     * split string by delimiter
+     * split string by delimiter, a regular expression. '$' in the string
+     * splits as well, and a trailing empty part is dropped
      */
     static void split( wrapped& w ) {
-        auto s = w.vstack.back();
+        auto s = std::move( w.vstack.back() );
         w.vstack.pop_back();
-        auto b = w.vstack.back();
+        auto re = pattern::cache::get( w.vstack.back().str() );
         w.vstack.pop_back();
-        std::regex e( b );
-        string     res  = std::regex_replace( s, e, "$" );
-        auto       argv = util::split( res, '$' );
-        auto       it   = argv.begin();
-        for ( ; it != argv.end(); it++ ) {
-            w.vstack.push_back( *it );
+
+        auto push = [&w]( boost::string_view part ) {
+            for ( ;; ) {
+                auto d = part.find( '$' );
+                w.vstack.emplace_back( part.substr( 0, d ) );
+                if ( d == boost::string_view::npos ) break;
+                part.remove_prefix( d + 1 );
+            }
+        };
+
+        std::string scratch;
+        auto        t   = s.text( scratch );
+        auto        pos = t.begin();
+        for ( std::cregex_iterator it( t.begin(), t.end(), *re ), end;
+              it != end; ++it ) {
+            auto from = t.begin() + it->position();
+            push( boost::string_view( pos, from - pos ) );
+            pos = from + it->length();
         }
+        push( boost::string_view( pos, t.end() - pos ) );
+        if ( w.vstack.back().view().empty() ) w.vstack.pop_back();
+    }
+
+    /*
+     * grep / filter
+     * keep / drop the entries of vstack holding a match of the pattern
+     * on top, in one pass
+     */
+    static void grep( wrapped& w ) {
+        keep_if( w, true );
+    }
+
+    static void filter( wrapped& w ) {
+        keep_if( w, false );
+    }
+
+    static void keep_if( wrapped& w, bool keep ) {
+        auto re = pattern::cache::get( w.vstack.back().str() );
+        w.vstack.pop_back();
+        std::string scratch;
+        auto        end = std::remove_if(
+            w.vstack.begin(), w.vstack.end(), [&]( const value& v ) {
+                return pattern::search( v.text( scratch ), *re ) != keep;
+            } );
+        w.vstack.erase( end, w.vstack.end() );
+    }
+
+    /*
+     * match
+     * pop the pattern and a value, push 1 if the whole value matches
+     */
+    static void match( wrapped& w ) {
+        auto re = pattern::cache::get( w.vstack.back().str() );
+        w.vstack.pop_back();
+        std::string scratch;
+        bool        m = pattern::match( w.vstack.back().text( scratch ), *re );
+        w.vstack.pop_back();
+        w.vstack.push_back( value::integer( m ? 1 : 0 ) );
     }
 
     /*
@@ -263,14 +733,12 @@ class Operate {
      * evaluate one line from vstack
      */
     static void parse( wrapped& w ) {
-        auto s = w.vstack.back();
+        auto s = w.vstack.back().str();
         w.vstack.pop_back();
-        string res  = util::easy_type( s );
-        auto   argv = util::split( res, '$' );
-        auto   it   = argv.begin();
-        for ( ; it != argv.end(); it++ ) {
-            w.astack.push_back( *it );
-        }
+        string      res = util::easy_type( s );
+        util::views argv;
+        util::split_view( res, '$', argv );
+        call( w, argv );
     }
 
     /*
@@ -291,7 +759,8 @@ class Operate {
      * return the size of vstack
      */
     static void size( wrapped& w ) {
-        w.vstack.push_back( std::to_string( w.vstack.size() ) );
+        w.vstack.push_back(
+            value::integer( static_cast<std::int64_t>( w.vstack.size() ) ) );
     }
 
     /*
@@ -299,29 +768,29 @@ class Operate {
      * print whole vstack from bottom to top
      */
     static void print( wrapped& w ) {
+        std::string p;
+        for ( auto& v : w.vstack ) {
+            if ( !p.empty() ) p += ' ';
+            v.write( p );
+        }
         if ( w.editor )
-            w.editor->block.print_content( std::accumulate(
-                w.vstack.begin(), w.vstack.end(), string( "" ),
-                []( const string& s1, const string& s2 ) -> string {
-                    return s1.empty() ? s2 : s1 + " " + s2;
-                } ) );
+            w.editor->block.print_content( p );
         else
-            std::cout << std::accumulate(
-                             w.vstack.begin(), w.vstack.end(), string( "" ),
-                             []( const string& s1,
-                                 const string& s2 ) -> string {
-                                 return s1.empty() ? s2 : s1 + " " + s2;
-                             } )
-                      << std::endl;
+            std::cout << p << std::endl;
     }
 
+    /*
+     * print_limit
+     * print top n elements of vstack, each followed by a space
+     */
     static void print_limit( wrapped& w ) {
-        auto n = std::atoi( w.vstack.back().c_str() );
+        auto n = w.vstack.back().to_int();
         w.vstack.pop_back();
         std::string p;
-        for ( auto it = w.vstack.rbegin(); it != w.vstack.rend() && n > 0;
-              ++it, --n ) {
-            p = *it + " " + p;
+        auto        size = static_cast<std::int64_t>( w.vstack.size() );
+        for ( auto i = std::max<std::int64_t>( 0, size - n ); i < size; ++i ) {
+            w.vstack[i].write( p );
+            p += ' ';
         }
         if ( w.editor )
             w.editor->block.print_content( p );
@@ -334,7 +803,7 @@ class Operate {
      * pop n elements from vstack
      */
     static void drop( wrapped& w ) {
-        auto n = std::atoi( w.vstack.back().c_str() );
+        auto n = w.vstack.back().to_int();
         w.vstack.pop_back();
         while ( n-- > 0 ) {
             w.vstack.pop_back();
@@ -342,153 +811,229 @@ class Operate {
     }
 
     static void drop_one( wrapped& w ) {
-        w.vstack.push_back( "1" );
+        w.vstack.push_back( value::integer( 1 ) );
         drop( w );
     }
 
     /*
-     * if
+     * to
+     * send whole wrapped to client/server
      */
-    static void _if( wrapped& w ) {
-        bool                    _else_part = false;
-        std::deque<std::string> t_deque;
-        std::deque<std::string> f_deque;
-
-        int level = 1;
-
-        while ( level > 0 ) {
-            if ( w.astack.back() == "if" ) ++level;
-            if ( w.astack.back() == "then" ) --level;
-            if ( level == 0 ) break;
-            if ( level == 1 && w.astack.back() == "else" ) {
-                _else_part = true;
-            } else if ( _else_part ) {
-                f_deque.push_back( w.astack.back() );
-            } else {
-                t_deque.push_back( w.astack.back() );
-            }
-            w.astack.pop_back();
-        }
-        w.astack.pop_back();
+    static void to( wrapped& w ) {
+        auto hostname = w.vstack.back().str();
+        w.vstack.pop_back();
+        w.server->sent_to( _pack_stack( w ), hostname );
+        w.astack.clear();
+    }
 
-        auto cond = w.vstack.back();
+    /*
+     * deprecated
+     */
+    static void broadcast( wrapped& w ) {
+        auto block = w.vstack.back().str();
         w.vstack.pop_back();
-        if ( cond == "0" ) {
-            // if false
-            while ( !f_deque.empty() ) {
-                w.astack.push_back( f_deque.back() );
-                f_deque.pop_back();
-            }
-        } else {
-            while ( !t_deque.empty() ) {
-                w.astack.push_back( t_deque.back() );
-                t_deque.pop_back();
-            }
-        }
+        w.server->broadcast( _pack_stack( w ),
+                             [&]( network::session_ptr session ) {
+                                 return block != session->hostname();
+                             } );
     }
 
     /*
-     * begin
+     * time
+     * push current time into vstack
      */
-    static void begin( wrapped& w ) {
-        std::deque<std::string> inner;
+    static void time( wrapped& w ) {
+        w.vstack.push_back( value::literal( util::get_time() ) );
+    }
 
-        auto it = w.astack.rbegin();
-        int  c  = 1;
+    /*
+     * allocs
+     * push number of heap allocations made by this thread so far
+     */
+    static void allocs( wrapped& w ) {
+        auto n = static_cast<std::int64_t>( arena::allocations() );
+        w.vstack.push_back( value::integer( n ) );
+    }
 
-        while ( c > 0 ) {
-            if ( *it == "begin" ) ++c;
-            if ( *it == "end" ) --c;
-            if ( c == 0 ) break;
-            inner.push_back( *it );
-            ++it;
+    /*
+     * stats
+     * push calls and nanoseconds spent of every word so far, summed over
+     * threads, the word taking most time first. then packages sent and
+     * received with the socket calls they took
+     */
+    static void stats( wrapped& w ) {
+        for ( auto& x : profile::snapshot() ) {
+            w.vstack.push_back( x.name + " calls=" + std::to_string( x.calls ) +
+                                " ns=" + std::to_string( x.ns ) );
         }
+        for ( auto& r : profile::traffic_rows() ) w.vstack.push_back( r );
+    }
 
-        w.astack.push_back( "begin" );
+    /*
+     * cpu / mem / load
+     * push metrics of this host read from /proc as "name=N" values, cpu
+     * in percent of the time since the previous cpu on this host
+     */
+    static void cpu( wrapped& w ) {
+        auto c = metrics::sample_cpu();
+        w.vstack.push_back( field( "busy", c.busy, 1 ) );
+        w.vstack.push_back( field( "user", c.user, 1 ) );
+        w.vstack.push_back( field( "system", c.system, 1 ) );
+        w.vstack.push_back( field( "iowait", c.iowait, 1 ) );
+        w.vstack.push_back( field( "idle", c.idle, 1 ) );
+    }
 
-        while ( !inner.empty() ) {
-            w.astack.push_back( inner.back() );
-            inner.pop_back();
-        }
+    static void mem( wrapped& w ) {
+        auto m = metrics::sample_memory();
+        w.vstack.push_back( field( "total_kb", m.total_kb ) );
+        w.vstack.push_back( field( "available_kb", m.available_kb ) );
+        w.vstack.push_back( field( "used_kb", m.used_kb ) );
+        w.vstack.push_back( field( "swap_total_kb", m.swap_total_kb ) );
+        w.vstack.push_back( field( "swap_used_kb", m.swap_used_kb ) );
+    }
+
+    static void load( wrapped& w ) {
+        auto l = metrics::sample_load();
+        w.vstack.push_back( field( "load1", l.one, 2 ) );
+        w.vstack.push_back( field( "load5", l.five, 2 ) );
+        w.vstack.push_back( field( "load15", l.fifteen, 2 ) );
+        w.vstack.push_back( field( "running", l.running ) );
+        w.vstack.push_back( field( "tasks", l.tasks ) );
     }
 
     /*
-     * exit
-     * break from loop
+     * disk / net
+     * push one value per device, "name read_bps=N write_bps=N busy=N" and
+     * "name rx_bps=N tx_bps=N", in bytes per second since the previous
+     * disk / net on this host
      */
-    static void exit( wrapped& w ) {
-        while ( !w.astack.empty() && w.astack.back() != "begin" ) {
-            w.astack.pop_back();
-        }
-        if ( !w.astack.empty() && w.astack.back() == "begin" ) {
-            w.astack.pop_back();
+    static void disk( wrapped& w ) {
+        for ( auto& d : metrics::sample_disks() ) {
+            w.vstack.push_back( d.name + " " +
+                                field( "read_bps", d.read_bps, 0 ) + " " +
+                                field( "write_bps", d.write_bps, 0 ) + " " +
+                                field( "busy", d.busy, 1 ) );
         }
-        int level = 1;
-        while ( !w.astack.empty() && level > 0 ) {
-            if ( w.astack.back() == "begin" ) ++level;
-            if ( w.astack.back() == "end" ) --level;
-            w.astack.pop_back();
+    }
+
+    static void net( wrapped& w ) {
+        for ( auto& l : metrics::sample_links() ) {
+            w.vstack.push_back( l.name + " " + field( "rx_bps", l.rx_bps, 0 ) +
+                                " " + field( "tx_bps", l.tx_bps, 0 ) );
         }
     }
 
     /*
-     * to
-     * send whole wrapped to client/server
+     * procs
+     * push what changed in the process table since the previous procs on
+     * this host, one value per process: "pid name start rss_kb=N",
+     * "pid name exit" or "pid name cpu=N rss_kb=N rss_delta_kb=N", cpu
+     * in percent of one cpu. the first procs reports every process as
+     * started
      */
-    static void to( wrapped& w ) {
-        auto hostname = w.vstack.back();
-        w.vstack.pop_back();
-        auto p = _pack( w );
-        w.server->sent_to( std::make_shared<network::Package>( p ), hostname );
-        w.astack.clear();
+    static void procs( wrapped& w ) {
+        for ( auto& p : metrics::sample_processes() ) {
+            auto head = std::to_string( p.pid ) + " " + p.name + " ";
+            switch ( p.what ) {
+                case metrics::process::START:
+                    w.vstack.push_back( head + "start " +
+                                        field( "rss_kb", p.rss_kb ) );
+                    break;
+                case metrics::process::EXIT:
+                    w.vstack.push_back( head + "exit" );
+                    break;
+                default:
+                    w.vstack.push_back(
+                        head + field( "cpu", p.cpu, 1 ) + " " +
+                        field( "rss_kb", p.rss_kb ) + " " +
+                        field( "rss_delta_kb", p.rss_delta_kb ) );
+            }
+        }
     }
 
-    /*
-     * deprecated
-     */
-    static void broadcast( wrapped& w ) {
-        auto block = w.vstack.back();
-        w.vstack.pop_back();
-        auto p = _pack( w );
-        w.server->broadcast( std::make_shared<network::Package>( p ),
-                             [&]( network::session_ptr session ) {
-                                 return block != session->hostname;
-                             } );
+    static std::string field( const char* name, std::int64_t n ) {
+        return std::string( name ) + "=" + std::to_string( n );
     }
 
-    /*
-     * time
-     * push current time into vstack
-     */
-    static void time( wrapped& w ) {
-        w.vstack.push_back( util::get_time() );
+    static std::string field( const char* name, double d, int digits ) {
+        char buf[64];
+        std::snprintf( buf, sizeof( buf ), "%s=%.*f", name, digits, d );
+        return buf;
     }
 
     /*
      * arithmatic operations
+     * two INTs give an INT, unless it does not fit, then a REAL as when
+     * either is one
      */
     static void minus( wrapped& w ) {
-        long a = std::stol( w.vstack.back() );
+        auto a = w.vstack.back().number();
         w.vstack.pop_back();
-        long b = std::stol( w.vstack.back() );
+        auto b = w.vstack.back().number();
         w.vstack.pop_back();
-        w.vstack.push_back( std::to_string( b - a ) );
+        std::int64_t r;
+        if ( a.type() == value::INT && b.type() == value::INT &&
+             !__builtin_sub_overflow( b.to_int(), a.to_int(), &r ) )
+            w.vstack.push_back( value::integer( r ) );
+        else
+            w.vstack.push_back( value::real( b.to_real() - a.to_real() ) );
     }
 
     static void add( wrapped& w ) {
-        long a = std::stol( w.vstack.back() );
+        auto a = w.vstack.back().number();
         w.vstack.pop_back();
-        long b = std::stol( w.vstack.back() );
+        auto b = w.vstack.back().number();
         w.vstack.pop_back();
-        w.vstack.push_back( std::to_string( a + b ) );
+        std::int64_t r;
+        if ( a.type() == value::INT && b.type() == value::INT &&
+             !__builtin_add_overflow( a.to_int(), b.to_int(), &r ) )
+            w.vstack.push_back( value::integer( r ) );
+        else
+            w.vstack.push_back( value::real( a.to_real() + b.to_real() ) );
+    }
+
+    static void mul( wrapped& w ) {
+        auto a = w.vstack.back().number();
+        w.vstack.pop_back();
+        auto b = w.vstack.back().number();
+        w.vstack.pop_back();
+        std::int64_t r;
+        if ( a.type() == value::INT && b.type() == value::INT &&
+             !__builtin_mul_overflow( a.to_int(), b.to_int(), &r ) )
+            w.vstack.push_back( value::integer( r ) );
+        else
+            w.vstack.push_back( value::real( a.to_real() * b.to_real() ) );
+    }
+
+    /*
+     * div
+     * b / a, stays an INT only when the division is exact and fits, the
+     * smallest INT over -1 does not
+     */
+    static void div( wrapped& w ) {
+        auto a = w.vstack.back().number();
+        w.vstack.pop_back();
+        auto b = w.vstack.back().number();
+        w.vstack.pop_back();
+        if ( a.type() == value::INT && b.type() == value::INT &&
+             a.to_int() != 0 &&
+             !( a.to_int() == -1 &&
+                b.to_int() == std::numeric_limits<std::int64_t>::min() ) &&
+             b.to_int() % a.to_int() == 0 )
+            w.vstack.push_back( value::integer( b.to_int() / a.to_int() ) );
+        else
+            w.vstack.push_back( value::real( b.to_real() / a.to_real() ) );
     }
 
     static void greater( wrapped& w ) {
-        long a = std::stol( w.vstack.back() );
+        auto a = w.vstack.back().number();
         w.vstack.pop_back();
-        long b = std::stol( w.vstack.back() );
+        auto b = w.vstack.back().number();
         w.vstack.pop_back();
-        w.vstack.push_back( b > a ? "1" : "0" );
+        bool r = a.type() == value::INT && b.type() == value::INT
+                     ? b.to_int() > a.to_int()
+                     : b.to_real() > a.to_real();
+        w.vstack.push_back( value::integer( r ? 1 : 0 ) );
     }
 
     static void equal( wrapped& w ) {
@@ -496,15 +1041,298 @@ class Operate {
         w.vstack.pop_back();
         auto b = w.vstack.back();
         w.vstack.pop_back();
-        w.vstack.push_back( b == a ? "1" : "0" );
+        w.vstack.push_back( value::integer( b == a ? 1 : 0 ) );
     }
 
-    static void sadd( wrapped& w ) {
-        auto a = w.vstack.back();
+    /*
+     * reductions
+     * take the whole vstack at once. values are read as numbers into one
+     * array first (see reduce.hpp), text that is no number is left out.
+     * while every value is an integer the result is exact, otherwise it
+     * is a REAL
+     */
+    typedef boost::container::pmr::vector<double>       reals;
+    typedef boost::container::pmr::vector<std::int64_t> integers;
+
+    // false when some value is no number
+    static bool numbers( wrapped& w, reals& r, integers& n ) {
+        auto all = true;
+        r.reserve( w.vstack.size() );
+        n.reserve( w.vstack.size() );
+        for ( auto& v : w.vstack ) {
+            std::int64_t i = 0;
+            double       d = 0;
+            reduce::kind k;
+            switch ( v.type() ) {
+                case value::INT:
+                    i = v.to_int();
+                    k = reduce::INT;
+                    break;
+                case value::REAL:
+                    d = v.to_real();
+                    k = reduce::REAL;
+                    break;
+                default:
+                    k = reduce::number( v.view(), i, d );
+            }
+            if ( k == reduce::INT ) {
+                n.push_back( i );
+                r.push_back( static_cast<double>( i ) );
+            } else if ( k == reduce::REAL ) {
+                r.push_back( d );
+            } else {
+                all = false;
+            }
+        }
+        if ( n.size() != r.size() ) n.clear();
+        return all;
+    }
+
+    template <typename Reduce>
+    static void reduction( wrapped& w, Reduce f ) {
+        auto     memory = w.vstack.get_allocator().resource();
+        reals    r( memory );
+        integers n( memory );
+        numbers( w, r, n );
+        w.vstack.clear();
+        if ( r.empty() ) return;
+        if ( n.empty() )
+            w.vstack.push_back( value::real( f( r.data(), r.size() ) ) );
+        else
+            w.vstack.push_back( value::integer( f( n.data(), n.size() ) ) );
+    }
+
+    static void sum( wrapped& w ) {
+        reduction( w, []( const auto* x, std::size_t n ) {
+            return reduce::sum( x, n );
+        } );
+        if ( w.vstack.empty() ) w.vstack.push_back( value::integer( 0 ) );
+    }
+
+    static void min( wrapped& w ) {
+        reduction( w, []( const auto* x, std::size_t n ) {
+            return reduce::min( x, n );
+        } );
+    }
+
+    static void max( wrapped& w ) {
+        reduction( w, []( const auto* x, std::size_t n ) {
+            return reduce::max( x, n );
+        } );
+    }
+
+    static void avg( wrapped& w ) {
+        auto     memory = w.vstack.get_allocator().resource();
+        reals    r( memory );
+        integers n( memory );
+        numbers( w, r, n );
+        w.vstack.clear();
+        if ( r.empty() ) return;
+        w.vstack.push_back( value::real( reduce::sum( r.data(), r.size() ) /
+                                         static_cast<double>( r.size() ) ) );
+    }
+
+    /*
+     * sort
+     * ascending, the largest on top. numbers are sorted by value when
+     * every value is a number, otherwise everything is sorted as text
+     */
+    static void sort( wrapped& w ) {
+        largest( w, w.vstack.size() );
+    }
+
+    /*
+     * topk k
+     * keep the k largest values in the order sort leaves them
+     */
+    static void topk( wrapped& w ) {
+        auto k = w.vstack.back().to_int();
         w.vstack.pop_back();
-        auto b = w.vstack.back();
+        largest( w, static_cast<std::size_t>( k > 0 ? k : 0 ) );
+    }
+
+    /*
+     * uniq
+     * drop a value equal to the one under it, as uniq(1) does
+     */
+    static void uniq( wrapped& w ) {
+        w.vstack.erase( std::unique( w.vstack.begin(), w.vstack.end() ),
+                        w.vstack.end() );
+    }
+
+    static void largest( wrapped& w, std::size_t k ) {
+        auto     memory = w.vstack.get_allocator().resource();
+        reals    r( memory );
+        integers n( memory );
+        if ( !numbers( w, r, n ) ) {
+            // numbers as text, a deque keeps them in place
+            std::deque<std::string>                           scratch;
+            boost::container::pmr::vector<boost::string_view> text( memory );
+            text.reserve( w.vstack.size() );
+            for ( auto& v : w.vstack ) {
+                if ( v.is_number() ) {
+                    scratch.push_back( v.str() );
+                    text.push_back( scratch.back() );
+                } else {
+                    text.push_back( v.view() );
+                }
+            }
+            keep_largest( w, text, k );
+        } else if ( !n.empty() ) {
+            keep_largest( w, n, k );
+        } else {
+            keep_largest( w, r, k );
+        }
+    }
+
+    // sorting positions by key, equal keys keep their order
+    template <typename Keys>
+    static void keep_largest( wrapped& w, const Keys& keys, std::size_t k ) {
+        auto size = keys.size();
+        k         = std::min( k, size );
+        boost::container::pmr::vector<std::uint32_t> at(
+            size, w.vstack.get_allocator().resource() );
+        for ( std::size_t i = 0; i < size; ++i ) {
+            at[i] = static_cast<std::uint32_t>( i );
+        }
+        auto less = [&keys]( std::uint32_t a, std::uint32_t b ) {
+            return keys[a] < keys[b] || ( !( keys[b] < keys[a] ) && a < b );
+        };
+        auto from = at.begin() + ( size - k );
+        if ( k < size ) std::nth_element( at.begin(), from, at.end(), less );
+        std::sort( from, at.end(), less );
+
+        boost::container::pmr::deque<value> kept(
+            w.vstack.get_allocator().resource() );
+        for ( auto it = from; it != at.end(); ++it ) {
+            kept.push_back( std::move( w.vstack[*it] ) );
+        }
+        w.vstack.swap( kept );
+    }
+
+    /*
+     * set operations
+     * "mark" bounds segments of vstack, a missing mark stands for the
+     * bottom. the top segment is a, the one below it b. both go with
+     * their marks and the result takes their place. values are the same
+     * when their text is, the result keeps the first of them in order
+     */
+    static void mark( wrapped& w ) {
+        w.vstack.push_back( value::mark() );
+    }
+
+    static void set_union( wrapped& w ) {
+        combine( w, UNION );
+    }
+
+    static void intersect( wrapped& w ) {
+        combine( w, INTERSECT );
+    }
+
+    static void diff( wrapped& w ) {
+        combine( w, DIFF );
+    }
+
+    /*
+     * count_distinct
+     * number of different values in the top segment
+     */
+    static void count_distinct( wrapped& w ) {
+        auto                    end   = w.vstack.size();
+        auto                    begin = segment( w, end );
+        text_set                seen( w.vstack.get_allocator().resource() );
+        std::deque<std::string> scratch;
+        for ( auto i = begin; i < end; ++i ) {
+            seen.insert( key( w.vstack[i], scratch ) );
+        }
+        auto n = static_cast<std::int64_t>( seen.size() );
+        w.vstack.erase( w.vstack.begin() + ( begin ? begin - 1 : 0 ),
+                        w.vstack.end() );
+        w.vstack.push_back( value::integer( n ) );
+    }
+
+    struct text_hash {
+        std::size_t operator()( boost::string_view s ) const {
+            return boost::hash_range( s.begin(), s.end() );
+        }
+    };
+
+    typedef std::unordered_set<
+        boost::string_view, text_hash, std::equal_to<boost::string_view>,
+        boost::container::pmr::polymorphic_allocator<boost::string_view>>
+        text_set;
+
+    enum set_op { UNION, INTERSECT, DIFF };
+
+    // first position of the segment ending at end
+    static std::size_t segment( wrapped& w, std::size_t end ) {
+        while ( end > 0 && w.vstack[end - 1].type() != value::MARK ) --end;
+        return end;
+    }
+
+    // text of a value, a number is formatted into scratch
+    static boost::string_view key( const value&             v,
+                                   std::deque<std::string>& scratch ) {
+        if ( !v.is_number() ) return v.view();
+        scratch.push_back( v.str() );
+        return scratch.back();
+    }
+
+    static void combine( wrapped& w, set_op op ) {
+        auto a_end   = w.vstack.size();
+        auto a_begin = segment( w, a_end );
+        auto b_end   = a_begin ? a_begin - 1 : 0;
+        auto b_begin = segment( w, b_end );
+        auto cut     = b_begin ? b_begin - 1 : 0;
+
+        auto                    memory = w.vstack.get_allocator().resource();
+        text_set                in_a( memory ), seen( memory );
+        std::deque<std::string> scratch;
+        in_a.reserve( a_end - a_begin );
+        seen.reserve( a_end - cut );
+        for ( auto i = a_begin; i < a_end; ++i ) {
+            in_a.insert( key( w.vstack[i], scratch ) );
+        }
+
+        // positions first, the keys point into the values
+        boost::container::pmr::vector<std::size_t> kept( memory );
+        for ( auto i = b_begin; i < b_end; ++i ) {
+            auto k = key( w.vstack[i], scratch );
+            if ( !seen.insert( k ).second ) continue;
+            auto in = in_a.count( k ) > 0;
+            if ( op == UNION || ( op == INTERSECT && in ) ||
+                 ( op == DIFF && !in ) )
+                kept.push_back( i );
+        }
+        if ( op == UNION ) {
+            for ( auto i = a_begin; i < a_end; ++i ) {
+                if ( seen.insert( key( w.vstack[i], scratch ) ).second )
+                    kept.push_back( i );
+            }
+        }
+
+        boost::container::pmr::deque<value> result( memory );
+        for ( auto i : kept ) result.push_back( std::move( w.vstack[i] ) );
+        w.vstack.erase( w.vstack.begin() + cut, w.vstack.end() );
+        for ( auto& v : result ) w.vstack.push_back( std::move( v ) );
+    }
+
+    /*
+     * sadd
+     * a ++ b, the longer side grows in place so that a loop of ++ is
+     * amortized O(1) on whichever side the accumulated string is
+     */
+    static void sadd( wrapped& w ) {
+        auto a = std::move( w.vstack.back() );
         w.vstack.pop_back();
-        w.vstack.push_back( a + b );
+        auto& b = w.vstack.back();
+        if ( !a.is_number() &&
+             ( b.is_number() || a.view().size() > b.view().size() ) ) {
+            a.append( b );
+            b = std::move( a );
+        } else {
+            b.prepend( a );
+        }
     }
 
     /*
@@ -512,14 +1340,14 @@ class Operate {
      */
     static void list_host( wrapped& w ) {
         if ( w.server == nullptr ) return;
+        auto clients = w.server->get_clients();
         w.vstack.push_back( std::accumulate(
-            w.server->get_clients().begin(), w.server->get_clients().end(),
-            string( "" ),
+            clients.begin(), clients.end(), string( "" ),
             []( const string& s1, network::session_ptr s2 ) -> string {
                 return s1.empty()
-                           ? "[" + s2->get_client_s() + "] " + s2->hostname
+                           ? "[" + s2->get_client_s() + "] " + s2->hostname()
                            : s1 + "\n[" + s2->get_client_s() + "] " +
-                                 s2->hostname;
+                                 s2->hostname();
             } ) );
     }
 
@@ -529,9 +1357,8 @@ class Operate {
      */
     static void push_host( wrapped& w ) {
         if ( w.server == nullptr ) return;
-        for ( auto it = w.server->get_clients().begin();
-              it != w.server->get_clients().end(); ++it ) {
-            w.vstack.push_back( ( *it )->hostname );
+        for ( auto& c : w.server->get_clients() ) {
+            w.vstack.push_back( c->hostname() );
         }
     }
 
@@ -540,7 +1367,7 @@ class Operate {
      * register hostname
      */
     static void reg( wrapped& w ) {
-        w.session->hostname = w.vstack.back();
+        w.session->set_hostname( w.vstack.back().str() );
         w.vstack.pop_back();
     }
 
@@ -549,22 +1376,302 @@ class Operate {
      * send wrapped from client to server
      */
     static void forward( wrapped& w ) {
-        auto p = _pack( w );
-        if ( w.client )
-            w.client->send( std::make_shared<network::Package>( p ) );
+        if ( w.client ) w.client->send( _pack_stack( w ) );
         w.astack.clear();
     }
 
+    /*
+     * suspended
+     * rest of a call taken off the interpreter, to be run later or more
+     * than once (see system and stream)
+     */
+    struct suspended {
+        std::vector<std::string> tokens;
+        std::vector<value>       stack;
+        std::uint64_t            steps;
+        budget                   limit;
+        network::package_ptr     package;
+        network::session_ptr     session;
+        network::server_ptr      server;
+        network::client_ptr      client;
+        Editor*                  editor;
+    };
+
+    static std::shared_ptr<const suspended> suspend( wrapped& w ) {
+        auto s = std::make_shared<const suspended>(
+            suspended{remaining( w ),
+                      std::vector<value>( w.vstack.begin(), w.vstack.end() ),
+                      w.steps, w.limit, w.package, w.session, w.server,
+                      w.client, w.editor} );
+        w.astack.clear();
+        return s;
+    }
+
+    /*
+     * resume
+     * run the rest of a call with top pushed onto its vstack, the steps
+     * already run, and those run for it meanwhile, still count against
+     * the budget
+     */
+    static std::vector<value> resume( const suspended&   s,
+                                      std::vector<value> top,
+                                      std::uint64_t      ran = 0 ) {
+        arena::request memory;
+        wrapped        w( memory, s.package, s.session, s.server, s.client,
+                   s.editor );
+        w.steps = s.steps + ran;
+        w.limit = s.limit;
+        for ( auto& v : s.stack ) w.vstack.push_back( v );
+        for ( auto& v : top ) w.vstack.push_back( std::move( v ) );
+        call( w, s.tokens );
+        next( w );
+        return std::vector<value>( w.ostack.begin(), w.ostack.end() );
+    }
+
+    /*
+     * on_network
+     * run f on the network thread of the call, through its session when
+     * it has one, so that what a session waits for comes back in order
+     */
+    static void on_network( const suspended& s, std::function<void()> f ) {
+        if ( s.session )
+            s.session->post( std::move( f ) );
+        else if ( s.server )
+            s.server->post( std::move( f ) );
+        else
+            s.client->post( std::move( f ) );
+    }
+
     /*
      * system
      * system command and return output
      */
     static void system( wrapped& w ) {
-        auto command = w.vstack.back();
+        auto command = w.vstack.back().str();
+        w.vstack.pop_back();
+        launch( w, util::shell( command ) );
+    }
+
+    /*
+     * spawn
+     * run the segment above the top mark as argv, without a shell, and
+     * push the output. "spawn$/$-l$ls$mark" lists / with no /bin/sh started
+     */
+    static void spawn( wrapped& w ) {
+        auto                     from = segment( w, w.vstack.size() );
+        std::vector<std::string> argv;
+        for ( auto i = from; i < w.vstack.size(); ++i ) {
+            argv.push_back( w.vstack[i].str() );
+        }
+        w.vstack.erase( w.vstack.begin() + ( from ? from - 1 : 0 ),
+                        w.vstack.end() );
+        launch( w, argv );
+    }
+
+    /*
+     * measure
+     * system, then what the command cost as "name=N" values after its
+     * output: exit, user_us, sys_us, maxrss_kb, minflt, majflt, nvcsw,
+     * nivcsw and wall_us
+     */
+    static void measure( wrapped& w ) {
+        auto command = w.vstack.back().str();
+        w.vstack.pop_back();
+        launch( w, util::shell( command ), true );
+    }
+
+    /*
+     * launch
+     * push the output of argv, and its usage when measured. a command
+     * that cannot be started has no output, as when the shell does not
+     * find it, and exit 127
+     */
+    static void launch( wrapped& w, const std::vector<std::string>& argv,
+                        bool measured = false ) {
+        if ( !detachable( w ) ) {
+            util::usage u;
+            w.vstack.push_back( value::blob( output_of( argv, u ) ) );
+            if ( measured ) push_usage( w.vstack, u );
+            return;
+        }
+
+        // the rest of the call waits for the command off the network thread
+        auto rest   = suspend( w );
+        auto order  = sequence::of( rest->session, rest->client );
+        auto ticket = order->take();
+        boost::asio::post( processes(), [rest, argv, measured, order,
+                                         ticket] {
+            util::usage        u;
+            std::vector<value> top{value::blob( output_of( argv, u ) )};
+            if ( measured ) push_usage( top, u );
+            order->done( ticket, [rest, top] {
+                on_network( *rest, [rest, top] { resume( *rest, top ); } );
+            } );
+        } );
+    }
+
+    static std::string output_of( const std::vector<std::string>& argv,
+                                  util::usage&                    u ) {
+        try {
+            return util::exec( argv, false, &u );
+        } catch ( std::runtime_error& e ) {
+            std::cerr << e.what() << std::endl;
+            u.exit = 127;
+            return std::string();
+        }
+    }
+
+    template <typename Stack>
+    static void push_usage( Stack& vstack, const util::usage& u ) {
+        vstack.push_back( field( "exit", u.exit ) );
+        vstack.push_back( field( "user_us", u.user_us ) );
+        vstack.push_back( field( "sys_us", u.sys_us ) );
+        vstack.push_back( field( "maxrss_kb", u.maxrss_kb ) );
+        vstack.push_back( field( "minflt", u.minflt ) );
+        vstack.push_back( field( "majflt", u.majflt ) );
+        vstack.push_back( field( "nvcsw", u.nvcsw ) );
+        vstack.push_back( field( "nivcsw", u.nivcsw ) );
+        vstack.push_back( field( "wall_us", u.wall_us ) );
+    }
+
+    /*
+     * stream
+     * run the rest of the call once for every chunk of output of the
+     * command as it comes, with the chunk on top of vstack, and not at all
+     * when there is no output. off the network thread the next chunk is
+     * only read once the link the call came from has drained, so a slow
+     * reader at the other end holds the command rather than the memory,
+     * and the command is stopped once that link is gone. at most
+     * streams_max run so at once, past that the rest of the call gets an
+     * error in place of the output
+     */
+    enum { streams_max = 64 };
+
+    static void stream( wrapped& w ) {
+        auto command = w.vstack.back().str();
         w.vstack.pop_back();
 
-        auto output = util::exec( command.c_str(), false );
-        w.vstack.push_back( output );
+        if ( detachable( w ) && ++streams() > streams_max ) {
+            --streams();
+            w.vstack.push_back( "error: too many streams, " +
+                                std::to_string( streams_max ) + " running" );
+            return;
+        }
+
+        auto rest = suspend( w );
+        if ( !detachable( w ) ) {
+            auto sink = [&]( boost::string_view c ) {
+                auto out = resume( *rest, {value::blob( c.to_string() )} );
+                for ( auto& v : out ) w.ostack.push_back( std::move( v ) );
+                return true;
+            };
+            stream_of( util::shell( command ), sink );
+            return;
+        }
+
+        // false once the link is gone, the command is then dropped
+        auto sink = [rest]( boost::string_view c ) {
+            auto ready = std::make_shared<std::promise<bool>>();
+            auto alive = ready->get_future();
+            on_network( *rest, [rest, ready, chunk = c.to_string()] {
+                resume( *rest, {value::blob( chunk )} );
+                auto done = [ready]( bool ok ) { ready->set_value( ok ); };
+                if ( rest->session )
+                    rest->session->drained( done );
+                else if ( rest->client )
+                    rest->client->drained( done );
+                else
+                    done( true );
+            } );
+            try {
+                return alive.get();
+            } catch ( std::future_error& ) {
+                return false;  // the network loop has stopped
+            }
+        };
+
+        // a command may run for ever, it gets a thread of its own
+        std::thread( [command, sink] {
+            stream_of( util::shell( command ), sink );
+            --streams();
+        } ).detach();
+    }
+
+    // streams running off the network thread
+    static std::atomic<int>& streams() {
+        static std::atomic<int> n{0};
+        return n;
+    }
+
+    template <typename Sink>
+    static void stream_of( const std::vector<std::string>& argv, Sink& sink ) {
+        try {
+            util::exec_stream( argv, sink );
+        } catch ( std::runtime_error& e ) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    /*
+     * detachable
+     * a call run by the network thread for a package, its output goes
+     * nowhere but through the words it runs, so the rest of it may run
+     * later there. a call on a worker is waited for and runs on the spot
+     */
+    static bool detachable( wrapped& w ) {
+        return w.package && ( w.server || w.client ) && !worker();
+    }
+
+    /*
+     * sequence
+     * results of the commands run by one link, handed on in the order the
+     * commands were started however long each takes. commands of other
+     * links have their own and never wait for these
+     */
+    class sequence {
+       public:
+        std::uint64_t take() {
+            std::lock_guard<std::mutex> lock( _mutex );
+            return _taken++;
+        }
+
+        // f runs once the results of all earlier tickets have run
+        void done( std::uint64_t ticket, std::function<void()> f ) {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _ready.emplace( ticket, std::move( f ) );
+            for ( auto it = _ready.begin();
+                  it != _ready.end() && it->first == _next; ++_next ) {
+                it->second();
+                it = _ready.erase( it );
+            }
+        }
+
+        // of the link of a call, as dictionary::of
+        static std::shared_ptr<sequence> of( network::session_ptr session,
+                                             network::client_ptr  client ) {
+            if ( session ) return session->commands.get<sequence>();
+            if ( client ) return client->commands.get<sequence>();
+            static auto local = std::make_shared<sequence>();
+            return local;
+        }
+
+       private:
+        std::mutex                                     _mutex;
+        std::uint64_t                                  _taken = 0;
+        std::uint64_t                                  _next  = 0;
+        std::map<std::uint64_t, std::function<void()>> _ready;
+    };
+
+    /*
+     * processes
+     * threads running the commands of system, measure and spawn, a long
+     * command holds only its own thread. the order of the results is kept
+     * for each link by its sequence, not across links
+     */
+    static boost::asio::thread_pool& processes() {
+        static boost::asio::thread_pool pool(
+            std::max( 16u, std::thread::hardware_concurrency() ) );
+        return pool;
     }
 
     /*
@@ -572,7 +1679,7 @@ class Operate {
      * set local hostname and reg to server automatically
      */
     static void set_hostname( wrapped& w ) {
-        w.client->set_hostname( w.vstack.back() );
+        w.client->set_hostname( w.vstack.back().str() );
         w.vstack.pop_back();
         w.client->send( std::make_shared<network::Package>(
             "reg$" + w.client->hostname() ) );
@@ -591,56 +1698,278 @@ class Operate {
      * run script
      */
     static void run( wrapped& w ) {
-        auto filename = w.vstack.back();
+        auto filename = w.vstack.back().str();
         w.vstack.pop_back();
 
-        auto path = fs::path( script_dir + filename );
+        auto parsed = script::cache::load( script_dir + filename );
 
-        if ( !fs::exists( path ) ) {
+        if ( !parsed ) {
             return;
         }
 
-        fs::ifstream file;
-        file.open( path );
-        string str;
-        string command;
-
-        std::map<string, string> var;
+        std::vector<string> var( parsed->slots );
 
-        while ( getline( file, str ) ) {
-            if ( str.length() == 0 ) {
-                if ( !command.empty() ) {
-                    auto _ostack = Operate::process(
-                        _pack( w ) + "$promise$" + command, w.package,
-                        w.session, w.server, w.client, w.editor );
-                }
-                command = "";
+        for ( auto& step : parsed->steps ) {
+            if ( step.bind ) {
+                var[step.slot] = w.vstack.back().str();
+                w.vstack.pop_back();
                 continue;
             }
-            if ( str[0] == '#' ) {
-                var[str.substr( 1 )] = w.vstack.back();
-                w.vstack.pop_back();
+
+            // a block of a single empty line is nothing to run
+            if ( step.lines.size() == 1 &&
+                 step.lines[0].slot != script::parsed::npos &&
+                 var[step.lines[0].slot].empty() ) {
                 continue;
             }
-            if ( var.find( str ) != var.end() ) {
-                str = var[str];
+
+            // caller state, promise, then lines from the last to the first
+            auto argv = script::segments( _pack( w ) + "$promise" );
+            for ( auto it = step.lines.rbegin(); it != step.lines.rend();
+                  ++it ) {
+                if ( it->slot == script::parsed::npos ) {
+                    argv.insert( argv.end(), it->tokens.begin(),
+                                 it->tokens.end() );
+                } else {
+                    auto v = script::segments( var[it->slot] );
+                    argv.insert( argv.end(), v.begin(), v.end() );
+                }
             }
-            command = str + ( command.empty() ? "" : "$" ) + command;
+            if ( argv.back().empty() ) argv.pop_back();
+
+            std::uint64_t steps   = 0;
+            auto          _ostack = Operate::process(
+                argv, w.package, w.session, w.server, w.client, w.editor,
+                left( w ), &steps );
+            w.steps += steps;
+            if ( spent( w ) ) break;
         }
 
         w.astack.clear();
     }
 
+    /*
+     * prun
+     * run script with its blocks on the worker pool. a block reading the
+     * "#>VAR" output of an earlier one waits for it, the others of a wave
+     * run at once. each block runs on its own, without the rest of the
+     * caller, and the outputs bound to no variable are pushed into vstack
+     * block by block in script order once all are done. on the network
+     * thread the rest of the call is suspended meanwhile, nothing there
+     * waits for the blocks
+     */
+    static void prun( wrapped& w ) {
+        auto filename = w.vstack.back().str();
+        w.vstack.pop_back();
+
+        auto parsed = script::cache::load( script_dir + filename );
+
+        if ( !parsed ) {
+            return;
+        }
+        if ( spent( w ) ) {
+            w.astack.clear();
+            return;
+        }
+
+        const auto npos = script::parsed::npos;
+
+        auto p = std::make_shared<plan>();
+        p->parsed = parsed;
+        p->var.resize( parsed->slots );
+        for ( auto& s : parsed->steps ) {
+            if ( s.bind ) {
+                p->var[s.slot] = w.vstack.back().str();
+                w.vstack.pop_back();
+            } else {
+                p->blocks.push_back( &s );
+            }
+        }
+
+        // a variable is read from the latest block before writing it
+        auto&                                 blocks = p->blocks;
+        std::vector<std::size_t>              writer( parsed->slots, npos );
+        std::vector<std::vector<std::size_t>> from( blocks.size() );
+        std::vector<std::size_t>              wave( blocks.size(), 0 );
+        for ( std::size_t b = 0; b < blocks.size(); ++b ) {
+            for ( auto& l : blocks[b]->lines ) {
+                auto src = l.slot == npos ? npos : writer[l.slot];
+                from[b].push_back( src );
+                if ( src != npos )
+                    wave[b] = std::max( wave[b], wave[src] + 1 );
+            }
+            if ( blocks[b]->output != npos ) writer[blocks[b]->output] = b;
+        }
+        p->last  = blocks.empty()
+                      ? 0
+                      : *std::max_element( wave.begin(), wave.end() ) + 1;
+        p->from  = std::move( from );
+        p->wave  = std::move( wave );
+        p->out.resize( blocks.size() );
+        p->steps.resize( blocks.size(), 0 );
+        p->left    = left( w );
+        p->package = w.package;
+        p->session = w.session;
+        p->server  = w.server;
+        p->client  = w.client;
+        p->editor  = w.editor;
+
+        if ( detachable( w ) ) {
+            auto rest = suspend( w );
+            p->done   = [rest]( plan& p ) {
+                if ( p.spent() ) return;
+                auto top = outputs( p );
+                on_network( *rest, [rest, top, used = p.used] {
+                    resume( *rest, top, used );
+                } );
+            };
+            run_wave( p, 0 );
+            return;
+        }
+
+        // a worker cannot wait for the pool it holds, it runs them itself
+        std::promise<void> finished;
+        p->in_place = worker();
+        p->done     = [&finished]( plan& ) { finished.set_value(); };
+        run_wave( p, 0 );
+        finished.get_future().wait();
+
+        w.steps += p->used;
+        if ( spent( w ) ) {
+            w.astack.clear();
+            return;
+        }
+        for ( auto& v : outputs( *p ) ) w.vstack.push_back( std::move( v ) );
+    }
+
+    /*
+     * plan
+     * blocks of a prun, what they read and what they output, shared by
+     * the workers that run them
+     */
+    struct plan {
+        typedef script::parsed::step step;
+
+        std::shared_ptr<const script::parsed> parsed;
+        std::vector<string>                   var;
+        std::vector<const step*>              blocks;
+        std::vector<std::vector<std::size_t>> from;
+        std::vector<std::size_t>              wave;
+        std::vector<std::vector<value>>       out;
+        std::vector<std::uint64_t>            steps;
+        std::size_t                           last = 0;
+
+        budget                       left;      // of the caller
+        std::uint64_t                used = 0;  // steps of the waves done
+        budget                       share;     // of a block of this wave
+        std::atomic<std::size_t>     pending{0};
+        bool                         in_place = false;
+        std::function<void( plan& )> done;  // must not hold the plan itself
+
+        network::package_ptr package;
+        network::session_ptr session;
+        network::server_ptr  server;
+        network::client_ptr  client;
+        Editor*              editor;
+
+        bool spent() const {
+            return left.steps && used >= left.steps;
+        }
+    };
+
+    /*
+     * run_wave
+     * run the blocks of wave k, the last of them to end starts the next
+     * wave, and done runs after the last wave or once the steps are spent
+     */
+    static void run_wave( std::shared_ptr<plan> p, std::size_t k ) {
+        if ( k == p->last || p->spent() ) return p->done( *p );
+
+        // the blocks of a wave split what the call has left
+        auto n     = std::count( p->wave.begin(), p->wave.end(), k );
+        p->share   = split( p->left, p->used, 0, n );
+        p->pending = n;
+        for ( std::size_t b = 0; b < p->blocks.size(); ++b ) {
+            if ( p->wave[b] != k ) continue;
+            auto task = [p, b, k] {
+                worker() = true;
+                run_block( *p, b );
+                if ( --p->pending ) return;
+                for ( std::size_t i = 0; i < p->blocks.size(); ++i ) {
+                    if ( p->wave[i] == k ) p->used += p->steps[i];
+                }
+                run_wave( p, k + 1 );
+            };
+            if ( p->in_place )
+                task();
+            else
+                boost::asio::post( workers(), task );
+        }
+    }
+
+    static void run_block( plan& p, std::size_t b ) {
+        const auto               npos  = script::parsed::npos;
+        auto&                    lines = p.blocks[b]->lines;
+        std::vector<std::string> argv;
+        for ( auto i = lines.size(); i-- > 0; ) {
+            if ( lines[i].slot == npos ) {
+                argv.insert( argv.end(), lines[i].tokens.begin(),
+                             lines[i].tokens.end() );
+            } else if ( p.from[b][i] == npos ) {
+                auto v = script::segments( p.var[lines[i].slot] );
+                argv.insert( argv.end(), v.begin(), v.end() );
+            } else {
+                // pushed back in the order they were output
+                auto& o = p.out[p.from[b][i]];
+                for ( auto it = o.rbegin(); it != o.rend(); ++it ) {
+                    argv.push_back( it->str() );
+                }
+            }
+        }
+        if ( argv.empty() ) return;
+        p.out[b] = Operate::process( argv, p.package, p.session, p.server,
+                                     p.client, p.editor, p.share,
+                                     &p.steps[b] );
+    }
+
+    // outputs bound to no variable, block by block in script order
+    static std::vector<value> outputs( plan& p ) {
+        std::vector<value> top;
+        for ( std::size_t b = 0; b < p.blocks.size(); ++b ) {
+            if ( p.blocks[b]->output != script::parsed::npos ) continue;
+            for ( auto& v : p.out[b] ) top.push_back( std::move( v ) );
+        }
+        return top;
+    }
+
+    // true on a thread of the worker pool
+    static bool& worker() {
+        static thread_local bool w = false;
+        return w;
+    }
+
+    static boost::asio::thread_pool& workers() {
+        static boost::asio::thread_pool pool(
+            std::max( 2u, std::thread::hardware_concurrency() ) );
+        return pool;
+    }
+
     /*
      * promise
      * make remaining call stack run after script asynchronous
      */
     static void promise( wrapped& w ) {
         w.vstack.clear();
-        while ( !w.astack.empty() &&
-                fn_map.find( w.astack.back() ) == fn_map.end() ) {
-            w.vstack.push_back( w.astack.back() );
-            w.astack.pop_back();
+        while ( !w.astack.empty() ) {
+            auto& f = w.astack.back();
+            if ( f.pc >= f.code->size() ) {
+                w.astack.pop_back();
+                continue;
+            }
+            auto& ins = ( *f.code )[f.pc];
+            if ( ins.op != bytecode::PUSH ) break;
+            w.vstack.push_back( ins.data );
+            ++f.pc;
         }
         while ( !w.ostack.empty() ) {
             w.vstack.push_back( w.ostack.front() );
@@ -655,11 +1984,8 @@ class Operate {
     static void s_list_host( wrapped& w ) {
         w.astack.clear();
         w.vstack.clear();
-        w.astack.push_back( "print" );
-        w.astack.push_back( "->" );
-        w.astack.push_back( w.client->hostname() );
-        w.astack.push_back( "list_host" );
-        w.astack.push_back( "->>" );
+        auto host = w.client->hostname();
+        call( w, util::views{"print", "->", host, "list_host", "->>"} );
     }
 
     /*
@@ -667,7 +1993,7 @@ class Operate {
      * send file to
      */
     static void sft( wrapped& w ) {
-        auto filename = w.vstack.back();
+        auto filename = w.vstack.back().str();
         w.vstack.pop_back();
 
         try {
@@ -680,7 +2006,7 @@ class Operate {
                 file->open( filename );
             }
             if ( w.server ) {
-                auto hostname = w.vstack.back();
+                auto hostname = w.vstack.back().str();
                 w.vstack.pop_back();
                 w.server->sent_to( std::make_shared<network::Package>( file ),
                                    hostname );
@@ -716,7 +2042,7 @@ class Operate {
 
         --file_count;
 
-        auto filename = w.vstack.back();
+        auto filename = w.vstack.back().str();
         w.vstack.pop_back();
 
         try {
@@ -746,7 +2072,7 @@ class Operate {
      * list dir and file recursively
      */
     static void tree( wrapped& w ) {
-        auto dir = w.vstack.back();
+        auto dir = w.vstack.back().str();
         w.vstack.pop_back();
 
         fs::path full_path( fs::initial_path<fs::path>() );
@@ -770,62 +2096,145 @@ class Operate {
     }
 
    private:
-    typedef std::map<std::string, std::function<void( Operate::wrapped& )>>
-                 FnMap;
+    typedef std::map<std::string, fn, std::less<>> FnMap;
     static FnMap fn_map;
 };
 
+bool Operate::word::operator()( wrapped& w ) const {
+    if ( native ) {
+        native( w );
+    } else if ( runtime ) {
+        ( *runtime )( w );
+    } else {
+        auto code = std::atomic_load( &defined->code );
+        if ( !code ) return false;
+        w.astack.push_back( frame{std::move( code ), 0} );
+    }
+    return true;
+}
+
+/*
+ * build-in words
+ */
+typedef words::entry<void ( * )( Operate::wrapped& )> builtin;
+
+constexpr builtin builtins[] = {
+    {"dup", &Operate::dup},
+    {"swap", &Operate::swap},
+    {"size", &Operate::size},
+    {"print", &Operate::print},
+    {"print_limit", &Operate::print_limit},
+    {"drop_one", &Operate::drop_one},
+    {"drop", &Operate::drop},
+    {"lwc", &Operate::lwc},
+    {"upc", &Operate::upc},
+    {"split", &Operate::split},
+    {"grep", &Operate::grep},
+    {"filter", &Operate::filter},
+    {"match", &Operate::match},
+    {"newline", &Operate::newline},
+    {"\\n", &Operate::newline},
+    {"_", &Operate::empty},
+    {"parse", &Operate::parse},
+    {"*", &Operate::output},
+    {"promise", &Operate::promise},
+    // archimatic operation
+    {"-", &Operate::minus},
+    {"+", &Operate::add},
+    {">", &Operate::greater},
+    {"==", &Operate::equal},
+    {"++", &Operate::sadd},
+    {"mul", &Operate::mul},
+    {"div", &Operate::div},
+    // whole vstack
+    {"sum", &Operate::sum},
+    {"min", &Operate::min},
+    {"max", &Operate::max},
+    {"avg", &Operate::avg},
+    {"sort", &Operate::sort},
+    {"uniq", &Operate::uniq},
+    {"topk", &Operate::topk},
+    {"mark", &Operate::mark},
+    {"union", &Operate::set_union},
+    {"intersect", &Operate::intersect},
+    {"diff", &Operate::diff},
+    {"count_distinct", &Operate::count_distinct},
+    // network operation
+    {"->>", &Operate::forward},
+    {"forward", &Operate::forward},
+    {"reg", &Operate::reg},
+    {"->", &Operate::to},
+    {"to", &Operate::to},
+    {"system", &Operate::system},
+    {"stream", &Operate::stream},
+    {"spawn", &Operate::spawn},
+    {"measure", &Operate::measure},
+    {"time", &Operate::time},
+    {"allocs", &Operate::allocs},
+    {"stats", &Operate::stats},
+    {"cpu", &Operate::cpu},
+    {"mem", &Operate::mem},
+    {"load", &Operate::load},
+    {"disk", &Operate::disk},
+    {"net", &Operate::net},
+    {"procs", &Operate::procs},
+    {"broadcast", &Operate::broadcast},
+    {"set_hostname", &Operate::set_hostname},
+    {"hostname", &Operate::hostname},
+    {"list_host", &Operate::list_host},
+    {"push_host", &Operate::push_host},
+    {"run", &Operate::run},
+    {"prun", &Operate::prun},
+    // file stack operation
+    {"tree", &Operate::tree},
+    {"sft", &Operate::sft},
+    {"sf", &Operate::sft},
+    {"sendfile", &Operate::sft},
+    {"popfs", &Operate::popfs},
+    // sugar
+    {"@list_host", &Operate::s_list_host}};
+
+constexpr words::index builtin_index = words::build( builtins );
+
 /*
  * function map
+ * words registered at runtime
  */
-Operate::FnMap Operate::fn_map = {{"dup", &Operate::dup},
-                                  {"swap", &Operate::swap},
-                                  {"size", &Operate::size},
-                                  {"print", &Operate::print},
-                                  {"print_limit", &Operate::print_limit},
-                                  {"drop_one", &Operate::drop_one},
-                                  {"drop", &Operate::drop},
-                                  {"lwc", &Operate::lwc},
-                                  {"upc", &Operate::upc},
-                                  {"split", &Operate::split},
-                                  {"newline", &Operate::newline},
-                                  {"\\n", &Operate::newline},
-                                  {"_", &Operate::empty},
-                                  {"parse", &Operate::parse},
-                                  {"*", &Operate::output},
-                                  {"promise", &Operate::promise},
-                                  // archimatic operation
-                                  {"-", &Operate::minus},
-                                  {"+", &Operate::add},
-                                  {">", &Operate::greater},
-                                  {"==", &Operate::equal},
-                                  {"++", &Operate::sadd},
-                                  // cond operation
-                                  {"if", &Operate::_if},
-                                  {"begin", &Operate::begin},
-                                  {"exit", &Operate::exit},
-                                  // network operation
-                                  {"->>", &Operate::forward},
-                                  {"forward", &Operate::forward},
-                                  {"reg", &Operate::reg},
-                                  {"->", &Operate::to},
-                                  {"to", &Operate::to},
-                                  {"system", &Operate::system},
-                                  {"time", &Operate::time},
-                                  {"broadcast", &Operate::broadcast},
-                                  {"set_hostname", &Operate::set_hostname},
-                                  {"hostname", &Operate::hostname},
-                                  {"list_host", &Operate::list_host},
-                                  {"push_host", &Operate::push_host},
-                                  {"run", &Operate::run},
-                                  // file stack operation
-                                  {"tree", &Operate::tree},
-                                  {"sft", &Operate::sft},
-                                  {"sf", &Operate::sft},
-                                  {"sendfile", &Operate::sft},
-                                  {"popfs", &Operate::popfs},
-                                  // sugar
-                                  {"@list_host", &Operate::s_list_host}};
+Operate::FnMap Operate::fn_map;
+
+/*
+ * limits
+ * budget of every process call, [budget] steps / bytes of .config
+ */
+Operate::budget Operate::limits = {10000000, 64 * 1024 * 1024};
+
+bool Operate::lookup( boost::string_view token, word& w,
+                      const dictionary* words ) {
+    // profile ids of build-in words are their places in the table
+    static const bool named = [] {
+        for ( auto& b : builtins ) profile::name( b.name );
+        return true;
+    }();
+
+    auto b = words::find( builtins, builtin_index, token.data(),
+                          token.length() );
+    if ( b ) {
+        w.native = b->fn;
+        w.id     = static_cast<profile::id>( b - builtins );
+        return true;
+    }
+    auto it = fn_map.find( token );
+    if ( it != fn_map.end() ) {
+        w.runtime = &it->second;
+        w.id      = profile::name( token );
+        return true;
+    }
+    auto d = words ? words->find( token ) : nullptr;
+    if ( !d ) return false;
+    w.defined = d;
+    w.id      = profile::name( token );
+    return true;
+}
 
 // register command processor
 void register_processor( network::server_ptr server, network::client_ptr client,
@@ -834,21 +2243,37 @@ void register_processor( network::server_ptr server, network::client_ptr client,
         util::config _conf_remote;
         _conf_remote.read_config( util::get_working_path() + "/.config" );
         script_dir = _conf_remote.value( "script", "dir" );
+
+        if ( _conf_remote.exist( "budget", "steps" ) )
+            Operate::limits.steps =
+                std::stoull( _conf_remote.value( "budget", "steps" ) );
+        if ( _conf_remote.exist( "budget", "bytes" ) )
+            Operate::limits.bytes =
+                std::stoull( _conf_remote.value( "budget", "bytes" ) );
     }
 
     if ( server )
         server->on( "recv_package", [editor]( network::package_ptr package,
                                               network::session_ptr session,
                                               network::server_ptr  server ) {
-            Operate::process( string( package->body(), package->body_length() ),
-                              package, session, server, NULL, editor );
+            boost::string_view body( package->body(), package->body_length() );
+            if ( package->is_stack() )
+                Operate::process_stack( body, package, session, server, NULL,
+                                        editor );
+            else
+                Operate::process( body, package, session, server, NULL,
+                                  editor );
         } );
 
     if ( client )
         client->on( "recv_package", [editor]( network::package_ptr package,
                                               network::client_ptr client ) {
-            Operate::process( string( package->body(), package->body_length() ),
-                              package, NULL, NULL, client, editor );
+            boost::string_view body( package->body(), package->body_length() );
+            if ( package->is_stack() )
+                Operate::process_stack( body, package, NULL, NULL, client,
+                                        editor );
+            else
+                Operate::process( body, package, NULL, NULL, client, editor );
         } );
     return;
 }
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/completion_condition.hpp>
+
+#include "package.hpp"
+#include "profile.hpp"
+
+namespace network {
+
+/*
+ * frames
+ * receive buffer of a connection. one read takes as much as the socket
+ * has, and every package complete in the buffer then comes out of next
+ * without another read, so a burst of small packages costs one syscall
+ *
+ * a body that cannot fit in the buffer is read straight into its package
+ * instead, see straight and rest
+ *
+ * the buffer starts at initial bytes, an idle link costs no more. it
+ * grows up to capacity for a frame that needs more or for a read that
+ * filled it, and goes back to initial once a small read has emptied it
+ */
+class frames {
+   public:
+    enum { capacity = 64 * 1024, initial = 4 * 1024 };
+
+    frames() : _buffer( new char[initial] ), _size( initial ) {}
+
+    frames( const frames& ) = delete;
+    frames& operator=( const frames& ) = delete;
+
+    // free room for the next read, what is left unparsed moves to the front
+    boost::asio::mutable_buffers_1 space() {
+        if ( _begin > 0 ) {
+            std::memmove( _buffer.get(), _buffer.get() + _begin,
+                          _end - _begin );
+            _end -= _begin;
+            _begin = 0;
+        }
+
+        std::size_t size = _size;
+        if ( _end == 0 && !_partial && !_full && _last < initial ) {
+            size = initial;
+        } else {
+            // the header, or the body of the partial package, must fit
+            std::size_t need =
+                _partial ? _partial->body_length() : Package::header_len();
+            while ( size < capacity && ( size < need || _full ) ) {
+                size *= 2;
+                _full = false;
+            }
+        }
+        if ( size != _size ) resize( size );
+
+        return boost::asio::buffer( _buffer.get() + _end, _size - _end );
+    }
+
+    // n bytes were read into space
+    void filled( std::size_t n ) {
+        profile::count( profile::links().reads );
+        _full = _end + n == _size;
+        _last = n;
+        _end += n;
+    }
+
+    /*
+     * next
+     * package complete in the buffer, nullptr once the buffer ends within
+     * a header or a body
+     */
+    package_ptr next() {
+        if ( _broken || _straight ) return nullptr;
+
+        if ( !_partial ) {
+            if ( _end - _begin < Package::header_len() ) return nullptr;
+            auto p = std::make_shared<Package>();
+            std::memcpy( p->data(), _buffer.get() + _begin,
+                         Package::header_len() );
+            _begin += Package::header_len();
+            if ( !p->decrypt() ) {
+                _broken = true;
+                return nullptr;
+            }
+            _partial = p;
+        }
+
+        std::size_t length = _partial->body_length();
+        std::size_t ready  = std::min( length, _end - _begin );
+        if ( ready < length && length <= capacity ) return nullptr;
+
+        if ( ready ) {
+            std::memcpy( _partial->body(), _buffer.get() + _begin, ready );
+            _begin += ready;
+        }
+        if ( ready < length ) {
+            _got      = ready;
+            _straight = true;
+            return nullptr;
+        }
+        return take();
+    }
+
+    // a package has begun and is not complete yet
+    bool partial() const {
+        return _partial != nullptr;
+    }
+
+    // the header was not understood, the link cannot go on
+    bool broken() const {
+        return _broken;
+    }
+
+    // the body of the partial package is to be read into rest
+    bool straight() const {
+        return _straight;
+    }
+
+    boost::asio::mutable_buffers_1 rest() {
+        return boost::asio::buffer( _partial->body() + _got,
+                                    _partial->body_length() - _got );
+    }
+
+    // the partial package, once rest was read
+    package_ptr finish() {
+        profile::count( profile::links().reads );
+        _straight = false;
+        return take();
+    }
+
+   private:
+    // what is in the buffer moves to one of size bytes, left uninitialized
+    void resize( std::size_t size ) {
+        std::unique_ptr<char[]> buffer( new char[size] );
+        std::memcpy( buffer.get(), _buffer.get(), _end );
+        _buffer = std::move( buffer );
+        _size   = size;
+    }
+
+    package_ptr take() {
+        profile::count( profile::links().received );
+        auto p = std::move( _partial );
+        _partial = nullptr;
+        _got     = 0;
+        return p;
+    }
+
+    std::unique_ptr<char[]> _buffer;
+    std::size_t             _size;
+    std::size_t             _begin = 0;
+    std::size_t             _end   = 0;
+    std::size_t             _last  = 0;      // bytes of the last read
+    bool                    _full  = false;  // it filled the room it had
+
+    package_ptr _partial;
+    std::size_t _got      = 0;  // bytes of its body read with the buffer
+    bool        _straight = false;
+    bool        _broken   = false;
+};
+
+/*
+ * gather
+ * packages at the front of a send queue, written with one call: at least
+ * one, and more while they fit in max_bytes
+ */
+class gather {
+   public:
+    enum { max_bytes = 64 * 1024, max_packages = 64 };
+
+    const std::vector<boost::asio::const_buffer>& take(
+        const std::deque<package_ptr>& queue ) {
+        _buffers.clear();
+        _bytes = 0;
+        for ( auto& p : queue ) {
+            if ( !_buffers.empty() && ( _buffers.size() == max_packages ||
+                                        _bytes + p->length() > max_bytes ) )
+                break;
+            _buffers.push_back( boost::asio::buffer( p->data(), p->length() ) );
+            _bytes += p->length();
+        }
+        profile::count( profile::links().sent, _buffers.size() );
+        return _buffers;
+    }
+
+    // of the last take
+    std::size_t packages() const {
+        return _buffers.size();
+    }
+
+    std::size_t bytes() const {
+        return _bytes;
+    }
+
+    // completion condition of async_write, every call it allows is a write
+    static std::size_t counted( const boost::system::error_code& ec,
+                                std::size_t ) {
+        if ( ec ) return 0;
+        profile::count( profile::links().writes );
+        return boost::asio::detail::default_max_transfer_size;
+    }
+
+   private:
+    std::vector<boost::asio::const_buffer> _buffers;
+    std::size_t                            _bytes = 0;
+};
+}
@@ -0,0 +1,416 @@
+#include "metrics.hpp"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/utility/string_view.hpp>
+
+namespace {
+
+/*
+ * source
+ * file of /proc kept open, read from the start into a buffer kept from
+ * one read to the next
+ */
+class source {
+   public:
+    explicit source( const char* path )
+        : fd( open( path, O_RDONLY | O_CLOEXEC ) ), buffer( 4096 ) {}
+
+    ~source() {
+        if ( fd >= 0 ) close( fd );
+    }
+
+    source( const source& ) = delete;
+    source& operator=( const source& ) = delete;
+
+    // whole file, or nothing when it cannot be read
+    boost::string_view read() {
+        if ( fd < 0 ) return boost::string_view();
+        std::size_t size = 0;
+        for ( ;; ) {
+            if ( size == buffer.size() ) buffer.resize( 2 * size );
+            auto n = pread( fd, &buffer[size], buffer.size() - size, size );
+            if ( n < 0 && errno == EINTR ) continue;
+            if ( n < 0 ) return boost::string_view();
+            if ( n == 0 ) break;
+            size += n;
+        }
+        return boost::string_view( buffer.data(), size );
+    }
+
+   private:
+    int               fd;
+    std::vector<char> buffer;
+};
+
+/*
+ * cursor
+ * reads numbers and words off a buffer without copying it
+ */
+struct cursor {
+    const char* p;
+    const char* end;
+
+    explicit cursor( boost::string_view s )
+        : p( s.data() ), end( s.data() + s.size() ) {}
+
+    bool done() const {
+        return p >= end;
+    }
+
+    void blank() {
+        while ( p < end && ( *p == ' ' || *p == '\t' ) ) ++p;
+    }
+
+    // up to white space or ':'
+    boost::string_view word() {
+        blank();
+        auto from = p;
+        while ( p < end && *p != ' ' && *p != '\t' && *p != '\n' &&
+                *p != ':' )
+            ++p;
+        return boost::string_view( from, p - from );
+    }
+
+    std::uint64_t number() {
+        blank();
+        std::uint64_t n = 0;
+        while ( p < end && *p >= '0' && *p <= '9' ) {
+            n = n * 10 + ( *p++ - '0' );
+        }
+        return n;
+    }
+
+    // a field that may be negative, as the tpgid of a process with no
+    // terminal or the nice of one run before others
+    std::int64_t integer() {
+        blank();
+        bool minus = p < end && *p == '-';
+        if ( minus ) ++p;
+        auto n = static_cast<std::int64_t>( number() );
+        return minus ? -n : n;
+    }
+
+    double real() {
+        double d = static_cast<double>( number() );
+        if ( p < end && *p == '.' ) {
+            double scale = 0.1;
+            for ( ++p; p < end && *p >= '0' && *p <= '9'; ++p ) {
+                d += ( *p - '0' ) * scale;
+                scale /= 10;
+            }
+        }
+        return d;
+    }
+
+    void skip( char c ) {
+        blank();
+        if ( p < end && *p == c ) ++p;
+    }
+
+    void line() {
+        while ( p < end && *p != '\n' ) ++p;
+        if ( p < end ) ++p;
+    }
+};
+
+// seconds since boot, the time every counter of /proc starts from
+double uptime() {
+    timespec t;
+    clock_gettime( CLOCK_BOOTTIME, &t );
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+double percent( std::uint64_t part, std::uint64_t whole ) {
+    return whole ? 100.0 * part / whole : 0;
+}
+
+/*
+ * counters
+ * value of a set of counters at a time, for the rate to the next sample
+ */
+template <std::size_t N>
+struct counters {
+    double        at   = 0;
+    std::uint64_t n[N] = {};
+
+    // growth of counter i, 0 when it went back
+    std::uint64_t delta( const counters& now, std::size_t i ) const {
+        return now.n[i] > n[i] ? now.n[i] - n[i] : 0;
+    }
+};
+}
+
+namespace metrics {
+
+cpu sample_cpu() {
+    enum { USER, NICE, SYSTEM, IDLE, IOWAIT, IRQ, SOFTIRQ, STEAL, FIELDS };
+    static source               stat( "/proc/stat" );
+    static counters<FIELDS>     last;
+    static std::mutex           mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    counters<FIELDS> now;
+    cursor           c( stat.read() );
+    c.word();  // "cpu", the sum of all
+    for ( auto& n : now.n ) n = c.number();
+
+    std::uint64_t d[FIELDS], total = 0;
+    for ( std::size_t i = 0; i < FIELDS; ++i ) {
+        d[i] = last.delta( now, i );
+        total += d[i];
+    }
+    last = now;
+
+    cpu r;
+    r.user   = percent( d[USER] + d[NICE], total );
+    r.system = percent( d[SYSTEM] + d[IRQ] + d[SOFTIRQ], total );
+    r.iowait = percent( d[IOWAIT], total );
+    r.idle   = percent( d[IDLE], total );
+    r.busy   = percent( total - d[IDLE] - d[IOWAIT], total );
+    return r;
+}
+
+memory sample_memory() {
+    static source               meminfo( "/proc/meminfo" );
+    static std::mutex           mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    memory       r{};
+    std::int64_t swap_free = 0;
+    for ( cursor c( meminfo.read() ); !c.done(); c.line() ) {
+        auto key = c.word();
+        c.skip( ':' );
+        if ( key == "MemTotal" )
+            r.total_kb = c.number();
+        else if ( key == "MemAvailable" )
+            r.available_kb = c.number();
+        else if ( key == "SwapTotal" )
+            r.swap_total_kb = c.number();
+        else if ( key == "SwapFree" )
+            swap_free = c.number();
+    }
+    r.used_kb      = r.total_kb - r.available_kb;
+    r.swap_used_kb = r.swap_total_kb - swap_free;
+    return r;
+}
+
+load sample_load() {
+    static source               loadavg( "/proc/loadavg" );
+    static std::mutex           mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    load   r;
+    cursor c( loadavg.read() );
+    r.one     = c.real();
+    r.five    = c.real();
+    r.fifteen = c.real();
+    r.running = c.number();
+    c.skip( '/' );
+    r.tasks = c.number();
+    return r;
+}
+
+std::vector<disk> sample_disks() {
+    // fields after the name, see Documentation/admin-guide/iostats.rst
+    enum {
+        READS,
+        SECTORS_READ    = 2,
+        WRITES          = 4,
+        SECTORS_WRITTEN = 6,
+        IO_TICKS        = 9,
+        FIELDS
+    };
+    typedef std::map<std::string, counters<FIELDS>, std::less<>> by_name;
+
+    static source               diskstats( "/proc/diskstats" );
+    static by_name              last;
+    static std::mutex           mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    std::vector<disk> r;
+    auto              at = uptime();
+    for ( cursor c( diskstats.read() ); !c.done(); c.line() ) {
+        c.number();  // major
+        c.number();  // minor
+        auto name = c.word();
+        if ( name.empty() || name.starts_with( "loop" ) ||
+             name.starts_with( "ram" ) )
+            continue;
+
+        counters<FIELDS> now;
+        now.at = at;
+        for ( auto& n : now.n ) n = c.number();
+        if ( now.n[READS] == 0 && now.n[WRITES] == 0 ) continue;
+
+        auto it = last.find( name );
+        if ( it == last.end() )
+            it = last.emplace( name.to_string(), counters<FIELDS>() ).first;
+        auto& before = it->second;
+        auto  dt     = at - before.at;
+        if ( dt > 0 ) {
+            r.push_back( disk{
+                it->first, before.delta( now, SECTORS_READ ) * 512 / dt,
+                before.delta( now, SECTORS_WRITTEN ) * 512 / dt,
+                before.delta( now, IO_TICKS ) / ( dt * 10 )} );
+        }
+        before = now;
+    }
+    return r;
+}
+
+std::vector<link> sample_links() {
+    enum { RX_BYTES, TX_BYTES = 8, FIELDS };
+    typedef std::map<std::string, counters<FIELDS>, std::less<>> by_name;
+
+    static source               dev( "/proc/net/dev" );
+    static by_name              last;
+    static std::mutex           mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    std::vector<link> r;
+    auto              at = uptime();
+    cursor            c( dev.read() );
+    c.line();  // two lines of headings
+    c.line();
+    for ( ; !c.done(); c.line() ) {
+        auto name = c.word();
+        c.skip( ':' );
+        if ( name.empty() ) continue;
+
+        counters<FIELDS> now;
+        now.at = at;
+        for ( auto& n : now.n ) n = c.number();
+
+        auto it = last.find( name );
+        if ( it == last.end() )
+            it = last.emplace( name.to_string(), counters<FIELDS>() ).first;
+        auto& before = it->second;
+        auto  dt     = at - before.at;
+        if ( dt > 0 ) {
+            r.push_back( link{it->first, before.delta( now, RX_BYTES ) / dt,
+                              before.delta( now, TX_BYTES ) / dt} );
+        }
+        before = now;
+    }
+    return r;
+}
+
+bool parse_stat( boost::string_view line, proc_stat& s ) {
+    // fields after the name, counted from state
+    enum { UTIME = 11, STIME = 12, STARTTIME = 19, RSS = 21 };
+
+    // the name is in parentheses and may hold any of them
+    auto open = line.find( '(' ), close = line.rfind( ')' );
+    if ( open == line.npos || close == line.npos || close < open )
+        return false;
+
+    cursor c( line.substr( close + 1 ) );
+    c.word();  // state
+    std::int64_t f[RSS + 1];
+    for ( int i = 1; i <= RSS; ++i ) f[i] = c.integer();
+
+    s.name      = line.substr( open + 1, close - open - 1 );
+    s.ticks     = f[UTIME] + f[STIME];
+    s.started   = f[STARTTIME];
+    s.rss_pages = f[RSS];
+    return true;
+}
+
+std::vector<process> sample_processes() {
+    struct entry {
+        std::uint64_t started;  // ticks after boot, tells a reused pid
+        std::uint64_t ticks;    // user and system cpu
+        std::int64_t  rss_kb;
+        std::string   name;
+        unsigned      seen;
+    };
+
+    static DIR*                           proc = opendir( "/proc" );
+    static std::unordered_map<int, entry> last;
+    static unsigned                       round = 0;
+    static double                         at    = 0;
+    static const long                     hz    = sysconf( _SC_CLK_TCK );
+    static const long page = sysconf( _SC_PAGESIZE ) / 1024;  // in kB
+    static std::mutex     mutex;
+    std::lock_guard<std::mutex> lock( mutex );
+
+    std::vector<process> r;
+    if ( !proc ) return r;
+
+    auto now = uptime();
+    auto dt  = now - at;
+    at       = now;
+    ++round;
+
+    rewinddir( proc );
+    char buffer[1024];
+    while ( auto d = readdir( proc ) ) {
+        char* end;
+        int   pid = std::strtol( d->d_name, &end, 10 );
+        if ( *end || pid <= 0 ) continue;
+
+        // relative to /proc, no walk from the root for every process
+        std::snprintf( buffer, sizeof( buffer ), "%d/stat", pid );
+        int fd = openat( dirfd( proc ), buffer, O_RDONLY | O_CLOEXEC );
+        if ( fd < 0 ) continue;  // gone in between
+        auto n = read( fd, buffer, sizeof( buffer ) );
+        close( fd );
+        if ( n <= 0 ) continue;
+
+        proc_stat s;
+        if ( !parse_stat( boost::string_view( buffer, n ), s ) ) continue;
+
+        auto ticks   = s.ticks;
+        auto started = s.started;
+        auto rss_kb  = s.rss_pages * page;
+
+        auto it = last.find( pid );
+        if ( it != last.end() && it->second.started != started ) {
+            auto& e = it->second;
+            r.push_back(
+                process{process::EXIT, pid, e.name, 0, 0, -e.rss_kb} );
+            last.erase( it );
+            it = last.end();
+        }
+        if ( it == last.end() ) {
+            auto name = s.name.to_string();
+            r.push_back(
+                process{process::START, pid, name, 0, rss_kb, rss_kb} );
+            last.emplace( pid, entry{started, ticks, rss_kb, name, round} );
+            continue;
+        }
+
+        auto& e = it->second;
+        e.seen  = round;
+        if ( ticks != e.ticks || rss_kb != e.rss_kb ) {
+            double cpu = dt > 0 ? 100.0 * ( ticks - e.ticks ) / hz / dt : 0;
+            r.push_back( process{process::CHANGE, pid, e.name, cpu, rss_kb,
+                                 rss_kb - e.rss_kb} );
+            e.ticks  = ticks;
+            e.rss_kb = rss_kb;
+        }
+    }
+
+    for ( auto it = last.begin(); it != last.end(); ) {
+        if ( it->second.seen == round ) {
+            ++it;
+            continue;
+        }
+        auto& e = it->second;
+        r.push_back(
+            process{process::EXIT, it->first, e.name, 0, 0, -e.rss_kb} );
+        it = last.erase( it );
+    }
+    return r;
+}
+}
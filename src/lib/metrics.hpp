@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+namespace metrics {
+
+/*
+ * metrics
+ * cpu, memory, load, disk and network of this host read from /proc. the
+ * files are opened once and read again from the start on every sample,
+ * into buffers kept from the last time
+ *
+ * rates are taken against the previous sample of the same kind, by any
+ * thread. the first one is against boot, when all counters were 0
+ */
+
+// percent of cpu time since the previous sample
+struct cpu {
+    double busy;
+    double user;
+    double system;
+    double iowait;
+    double idle;
+};
+
+struct memory {
+    std::int64_t total_kb;
+    std::int64_t available_kb;
+    std::int64_t used_kb;  // total less available
+    std::int64_t swap_total_kb;
+    std::int64_t swap_used_kb;
+};
+
+struct load {
+    double       one;
+    double       five;
+    double       fifteen;
+    std::int64_t running;  // runnable tasks
+    std::int64_t tasks;
+};
+
+// a block device other than loop and ram, which has done some I/O
+struct disk {
+    std::string name;
+    double      read_bps;   // bytes per second
+    double      write_bps;
+    double      busy;       // percent of time with I/O in flight
+};
+
+struct link {
+    std::string name;
+    double      rx_bps;  // bytes per second
+    double      tx_bps;
+};
+
+/*
+ * process
+ * change of a process since the previous sample: started, exited, or
+ * used cpu or changed its rss. a pid used again by a new process is an
+ * exit and a start
+ */
+struct process {
+    enum event { START, EXIT, CHANGE };
+
+    event        what;
+    int          pid;
+    std::string  name;
+    double       cpu;  // percent of one cpu
+    std::int64_t rss_kb;
+    std::int64_t rss_delta_kb;
+};
+
+/*
+ * proc_stat
+ * what sample_processes reads of a /proc/[pid]/stat line, the name is a
+ * view into the line
+ */
+struct proc_stat {
+    boost::string_view name;
+    std::uint64_t      ticks;    // user and system cpu
+    std::uint64_t      started;  // ticks after boot, tells a reused pid
+    std::int64_t       rss_pages;
+};
+
+// false when line has no name in parentheses
+bool parse_stat( boost::string_view line, proc_stat& s );
+
+cpu                  sample_cpu();
+memory               sample_memory();
+load                 sample_load();
+std::vector<disk>    sample_disks();
+std::vector<link>    sample_links();
+std::vector<process> sample_processes();
+}
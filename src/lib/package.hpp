@@ -31,25 +31,35 @@ class Package : public std::enable_shared_from_this<Package> {
    public:
     enum { header_length = 15 };
     enum { size_length = 10 };
-    enum { _COMMAND = 1, _SEND_FILE = 2, _RECV_FILE = 3 };
+    // _STACK is a command in binary form, see wire.hpp
+    enum { _COMMAND = 1, _SEND_FILE = 2, _RECV_FILE = 3, _STACK = 4 };
     enum { max_body_length = 1024 };
+    // bytes waiting to be sent on a link before a stream pauses
+    enum { high_water = 256 * 1024 };
 
     static uint8_t header_len() {
         return header_length + size_length + 4;
     }
 
+    Package( const Package& ) = delete;
+    Package& operator=( const Package& ) = delete;
+
+    ~Package() {
+        free( _data );
+    }
+
     Package() : _body_length( 0 ) {
         _data =
             (char*)malloc( header_length + size_length + 4 + max_body_length );
         _type = _COMMAND;
     }
 
-    Package( std::string s ) {
+    Package( std::string s, std::size_t type = _COMMAND ) {
         std::uint32_t s_len = s.length();
 
         _data        = (char*)malloc( header_length + size_length + 4 + s_len );
         _body_length = s_len;
-        _type        = _COMMAND;
+        _type        = type;
         encrypt();
         std::memcpy( body(), s.c_str(), _body_length );
     }
@@ -76,7 +86,11 @@ class Package : public std::enable_shared_from_this<Package> {
     }
 
     bool is_command() {
-        return _type == _COMMAND;
+        return _type == _COMMAND || _type == _STACK;
+    }
+
+    bool is_stack() const {
+        return _type == _STACK;
     }
 
     bool is_file() {
@@ -123,7 +137,7 @@ class Package : public std::enable_shared_from_this<Package> {
         char type[4 + 1] = "";
         std::strncat( type, _data + header_length + size_length, 4 );
         _type = std::atoi( type );
-        if ( _type == _COMMAND ) {
+        if ( _type == _COMMAND || _type == _STACK ) {
             _data = (char*)realloc(
                 _data, header_length + size_length + 4 + _body_length );
         } else if ( _type == _SEND_FILE ) {
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/utility/string_view.hpp>
+
+namespace pattern {
+
+typedef std::shared_ptr<const std::regex> regex_ptr;
+
+/*
+ * cache
+ * compiled regular expressions by pattern, the least recently used one is
+ * dropped once there are more than capacity of them
+ */
+class cache {
+   public:
+    enum { capacity = 64 };
+
+    static regex_ptr get( const std::string& pattern ) {
+        {
+            std::lock_guard<std::mutex> lock( mutex() );
+            auto                        it = index().find( pattern );
+            if ( it != index().end() ) {
+                order().splice( order().begin(), order(), it->second );
+                return it->second->second;
+            }
+        }
+
+        // compile without holding the lock, it may take a while
+        auto re = std::make_shared<const std::regex>( pattern );
+
+        std::lock_guard<std::mutex> lock( mutex() );
+        auto                        it = index().find( pattern );
+        if ( it != index().end() ) return it->second->second;
+
+        order().emplace_front( pattern, re );
+        index()[pattern] = order().begin();
+        if ( order().size() > capacity ) {
+            index().erase( order().back().first );
+            order().pop_back();
+        }
+        return re;
+    }
+
+   private:
+    typedef std::list<std::pair<std::string, regex_ptr>> list;
+
+    static std::mutex& mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    static list& order() {
+        static list l;
+        return l;
+    }
+
+    static std::unordered_map<std::string, list::iterator>& index() {
+        static std::unordered_map<std::string, list::iterator> i;
+        return i;
+    }
+};
+
+inline bool search( boost::string_view s, const std::regex& re ) {
+    return std::regex_search( s.begin(), s.end(), re );
+}
+
+inline bool match( boost::string_view s, const std::regex& re ) {
+    return std::regex_match( s.begin(), s.end(), re );
+}
+}
@@ -0,0 +1,121 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace {
+
+struct registry {
+    std::mutex                                       mutex;
+    std::map<std::string, profile::id, std::less<>> ids;
+    std::vector<std::string>                         names;
+    std::vector<const profile::counter*>             live;
+    std::uint64_t retired_calls[profile::capacity] = {};
+    std::uint64_t retired_timed[profile::capacity] = {};
+    std::uint64_t retired_ns[profile::capacity]    = {};
+};
+
+registry& reg() {
+    static registry r;
+    return r;
+}
+
+/*
+ * table
+ * counters of one thread, listed in the registry while the thread runs
+ */
+struct table {
+    profile::counter c[profile::capacity];
+
+    table() {
+        std::lock_guard<std::mutex> lock( reg().mutex );
+        reg().live.push_back( c );
+    }
+
+    ~table() {
+        auto&                       r = reg();
+        std::lock_guard<std::mutex> lock( r.mutex );
+        for ( std::size_t i = 0; i < profile::capacity; ++i ) {
+            r.retired_calls[i] += c[i].calls.load( std::memory_order_relaxed );
+            r.retired_timed[i] += c[i].timed.load( std::memory_order_relaxed );
+            r.retired_ns[i] += c[i].ns.load( std::memory_order_relaxed );
+        }
+        r.live.erase( std::find( r.live.begin(), r.live.end(), c ) );
+    }
+};
+}
+
+profile::id profile::name( boost::string_view word ) {
+    auto&                       r = reg();
+    std::lock_guard<std::mutex> lock( r.mutex );
+    auto                        it = r.ids.find( word );
+    if ( it != r.ids.end() ) return it->second;
+
+    auto i = static_cast<id>( std::min<std::size_t>( r.names.size(),
+                                                     capacity - 1 ) );
+    if ( i < capacity - 1 ) r.names.push_back( word.to_string() );
+    r.ids.emplace( word.to_string(), i );
+    return i;
+}
+
+profile::counter* profile::local() {
+    static thread_local table t;
+    return t.c;
+}
+
+std::vector<profile::row> profile::snapshot() {
+    auto&                       r = reg();
+    std::lock_guard<std::mutex> lock( r.mutex );
+
+    std::vector<row> rows;
+    for ( std::size_t i = 0; i < capacity; ++i ) {
+        auto calls = r.retired_calls[i];
+        auto timed = r.retired_timed[i];
+        auto ns    = r.retired_ns[i];
+        for ( auto t : r.live ) {
+            calls += t[i].calls.load( std::memory_order_relaxed );
+            timed += t[i].timed.load( std::memory_order_relaxed );
+            ns += t[i].ns.load( std::memory_order_relaxed );
+        }
+        if ( !calls ) continue;
+        if ( timed ) ns = static_cast<std::uint64_t>(
+                         static_cast<double>( ns ) * calls / timed );
+        rows.push_back(
+            {i < r.names.size() ? r.names[i] : "(other)", calls, ns} );
+    }
+    std::sort( rows.begin(), rows.end(),
+               []( const row& a, const row& b ) { return a.ns > b.ns; } );
+    return rows;
+}
+
+profile::traffic& profile::links() {
+    static traffic t;
+    return t;
+}
+
+std::vector<std::string> profile::traffic_rows() {
+    auto row = []( const char* what, std::uint64_t packages,
+                   const char* calls_name, std::uint64_t calls ) {
+        char per[32];
+        std::snprintf( per, sizeof( per ), "%.3f",
+                       packages ? static_cast<double>( calls ) / packages : 0 );
+        return std::string( what ) + " packages=" + std::to_string( packages ) +
+               " " + calls_name + "=" + std::to_string( calls ) +
+               " per_package=" + per;
+    };
+
+    auto& t = links();
+    return {row( "sent", t.sent.load(), "writes", t.writes.load() ),
+            row( "received", t.received.load(), "reads", t.reads.load() )};
+}
+
+void profile::dump( std::ostream& out ) {
+    for ( auto& x : snapshot() ) {
+        out << x.name << " calls=" << x.calls << " ns=" << x.ns
+            << " avg=" << x.ns / x.calls << "\n";
+    }
+    for ( auto& r : traffic_rows() ) out << r << "\n";
+    out.flush();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include <boost/utility/string_view.hpp>
+
+namespace profile {
+
+/*
+ * id
+ * number of a word name, names past the capacity share the last counter
+ */
+typedef std::uint16_t id;
+
+enum { capacity = 512 };
+
+/*
+ * name
+ * id of a word name, given on first use
+ */
+id name( boost::string_view word );
+
+/*
+ * counter
+ * written by its own thread only, other threads just read it. every call
+ * is counted but only one in about sample calls is timed, reading the
+ * clock costs as much as a small word
+ */
+enum { sample = 16 };
+
+struct counter {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> timed{0};
+    std::atomic<std::uint64_t> ns{0};
+};
+
+/*
+ * local
+ * counters of the calling thread, summed into the totals when the
+ * thread exits
+ */
+counter* local();
+
+// monotonic nanoseconds, read through the vdso without a syscall
+inline std::uint64_t now() {
+    timespec t;
+    clock_gettime( CLOCK_MONOTONIC, &t );
+    return static_cast<std::uint64_t>( t.tv_sec ) * 1000000000u + t.tv_nsec;
+}
+
+inline void bump( std::atomic<std::uint64_t>& c, std::uint64_t n ) {
+    c.store( c.load( std::memory_order_relaxed ) + n,
+             std::memory_order_relaxed );
+}
+
+/*
+ * start
+ * time of a call to be timed, 0 otherwise. calls are picked at random, so
+ * a loop calling words in a fixed order does not always time the same one
+ */
+inline std::uint64_t start() {
+    static thread_local std::uint32_t x = 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x % sample ? 0 : now();
+}
+
+inline void record( id i, std::uint64_t started ) {
+    static thread_local counter* table = local();
+    auto& c = table[i];
+    bump( c.calls, 1 );
+    if ( started ) {
+        bump( c.timed, 1 );
+        bump( c.ns, now() - started );
+    }
+}
+
+struct row {
+    std::string   name;
+    std::uint64_t calls;
+    std::uint64_t ns;
+};
+
+/*
+ * snapshot
+ * counters of all threads by word, most time first. ns is estimated from
+ * the timed calls
+ */
+std::vector<row> snapshot();
+
+/*
+ * traffic
+ * packages and socket calls of every link of the process, written by any
+ * thread. calls per package tell how well reads and writes are batched
+ */
+struct traffic {
+    std::atomic<std::uint64_t> sent{0};
+    std::atomic<std::uint64_t> writes{0};
+    std::atomic<std::uint64_t> received{0};
+    std::atomic<std::uint64_t> reads{0};
+};
+
+traffic& links();
+
+inline void count( std::atomic<std::uint64_t>& c, std::uint64_t n = 1 ) {
+    c.fetch_add( n, std::memory_order_relaxed );
+}
+
+/*
+ * traffic_rows
+ * "sent packages=N writes=N per_package=X" and the same for received
+ */
+std::vector<std::string> traffic_rows();
+
+/*
+ * dump
+ * one line per word: name, calls, estimated total and average
+ * nanoseconds, then the traffic rows
+ */
+void dump( std::ostream& out );
+}
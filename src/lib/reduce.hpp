@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <boost/utility/string_view.hpp>
+
+namespace reduce {
+
+enum kind { NONE, INT, REAL };
+
+/*
+ * number
+ * read text as a whole as a number, white space around it aside. text
+ * such as "12\n" from system output reads as the INT 12
+ */
+inline kind number( boost::string_view s, std::int64_t& i, double& d ) {
+    const char* space = " \t\r\n";
+    auto        from  = s.find_first_not_of( space );
+    if ( from == boost::string_view::npos ) return NONE;
+    s = s.substr( from, s.find_last_not_of( space ) - from + 1 );
+
+    char buf[64];
+    if ( s.size() >= sizeof( buf ) ) return NONE;
+    s.copy( buf, s.size() );
+    buf[s.size()] = '\0';
+
+    char* end;
+    errno = 0;
+    i     = std::strtoll( buf, &end, 10 );
+    if ( end == buf + s.size() && errno == 0 ) return INT;
+    d = std::strtod( buf, &end );
+    if ( end == buf + s.size() ) return REAL;
+    return NONE;
+}
+
+/*
+ * fold
+ * reduce n doubles, two SSE2 registers at a time where there is SSE2.
+ * lanes are combined at the end, so a sum may differ from the one added
+ * in order in the last bits
+ */
+template <typename Vector, typename Scalar>
+double fold( const double* x, std::size_t n, double init, Vector vector,
+             Scalar scalar ) {
+    std::size_t i = 0;
+    double      r = init;
+#ifdef __SSE2__
+    __m128d a = _mm_set1_pd( init ), b = a;
+    for ( ; i + 4 <= n; i += 4 ) {
+        a = vector( a, _mm_loadu_pd( x + i ) );
+        b = vector( b, _mm_loadu_pd( x + i + 2 ) );
+    }
+    double lanes[2];
+    _mm_storeu_pd( lanes, vector( a, b ) );
+    r = scalar( lanes[0], lanes[1] );
+#endif
+    for ( ; i < n; ++i ) r = scalar( r, x[i] );
+    return r;
+}
+
+#ifdef __SSE2__
+#define REDUCE_VECTOR( f ) []( __m128d a, __m128d b ) { return f( a, b ); }
+#else
+#define REDUCE_VECTOR( f ) nullptr
+#endif
+
+inline double sum( const double* x, std::size_t n ) {
+    return fold( x, n, 0.0, REDUCE_VECTOR( _mm_add_pd ),
+                 []( double a, double b ) { return a + b; } );
+}
+
+inline double min( const double* x, std::size_t n ) {
+    return fold( x, n, std::numeric_limits<double>::infinity(),
+                 REDUCE_VECTOR( _mm_min_pd ),
+                 []( double a, double b ) { return b < a ? b : a; } );
+}
+
+inline double max( const double* x, std::size_t n ) {
+    return fold( x, n, -std::numeric_limits<double>::infinity(),
+                 REDUCE_VECTOR( _mm_max_pd ),
+                 []( double a, double b ) { return b > a ? b : a; } );
+}
+
+#undef REDUCE_VECTOR
+
+/*
+ * integers are summed exactly, the loop is plain enough for the
+ * compiler to vectorize
+ */
+inline std::int64_t sum( const std::int64_t* x, std::size_t n ) {
+    std::uint64_t s = 0;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        s += static_cast<std::uint64_t>( x[i] );
+    }
+    return static_cast<std::int64_t>( s );
+}
+
+inline std::int64_t min( const std::int64_t* x, std::size_t n ) {
+    auto m = std::numeric_limits<std::int64_t>::max();
+    for ( std::size_t i = 0; i < n; ++i ) m = x[i] < m ? x[i] : m;
+    return m;
+}
+
+inline std::int64_t max( const std::int64_t* x, std::size_t n ) {
+    auto m = std::numeric_limits<std::int64_t>::min();
+    for ( std::size_t i = 0; i < n; ++i ) m = x[i] > m ? x[i] : m;
+    return m;
+}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace script {
+
+/*
+ * segments
+ * split by '$' keeping empty segments, so that joining the segments of
+ * several strings gives the segments of the joined string
+ */
+static std::vector<std::string> segments( const std::string& s ) {
+    std::vector<std::string> out;
+    std::string::size_type   from = 0, to;
+    while ( ( to = s.find( '$', from ) ) != std::string::npos ) {
+        out.push_back( s.substr( from, to - from ) );
+        from = to + 1;
+    }
+    out.push_back( s.substr( from ) );
+    return out;
+}
+
+static struct timespec mtime( const struct stat& st ) {
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+/*
+ * parsed script
+ * blocks are separated by blank lines, "#VAR" pops one value from vstack
+ * into VAR, and a line equal to a bound variable is replaced by its value.
+ * "#>VAR" in a block binds the output of the block to VAR, for prun
+ */
+class parsed {
+   public:
+    static const std::size_t npos = static_cast<std::size_t>( -1 );
+
+    /*
+     * line of a block, either tokens or the variable slot it refers to
+     */
+    struct line {
+        std::size_t              slot;
+        std::vector<std::string> tokens;
+    };
+
+    /*
+     * step
+     * bind pops into a slot, otherwise run the block, output is the slot
+     * of its "#>VAR"
+     */
+    struct step {
+        bool              bind;
+        std::size_t       slot;
+        std::vector<line> lines;
+        std::size_t       output = npos;
+    };
+
+    static std::shared_ptr<const parsed> read( std::istream& in ) {
+        auto p = std::make_shared<parsed>();
+
+        std::map<std::string, std::size_t> var;
+        std::vector<line>                  block;
+        std::string                        str;
+        std::size_t                        output = npos;
+
+        while ( getline( in, str ) ) {
+            if ( str.length() == 0 ) {
+                if ( !block.empty() ) {
+                    p->steps.push_back( step{false, npos, block, output} );
+                    output = npos;
+                }
+                block.clear();
+                continue;
+            }
+            if ( str.compare( 0, 2, "#>" ) == 0 ) {
+                output               = p->slots++;
+                var[str.substr( 2 )] = output;
+                continue;
+            }
+            if ( str[0] == '#' ) {
+                var[str.substr( 1 )] = p->slots;
+                p->steps.push_back( step{true, p->slots++, {}} );
+                continue;
+            }
+            auto it = var.find( str );
+            if ( it == var.end() ) {
+                block.push_back( line{npos, segments( str )} );
+            } else {
+                block.push_back( line{it->second, {}} );
+            }
+        }
+
+        return p;
+    }
+
+    std::vector<step> steps;
+    std::size_t       slots = 0;
+};
+
+/*
+ * cache
+ * parsed scripts keyed by path, an entry is dropped once the file on disk
+ * is not the same one (device, inode, size or mtime changed)
+ */
+class cache {
+   public:
+    static std::shared_ptr<const parsed> load( const std::string& path ) {
+        struct stat st;
+        if ( ::stat( path.c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) ) {
+            return nullptr;
+        }
+
+        static std::mutex                   mutex;
+        static std::map<std::string, entry> entries;
+
+        std::lock_guard<std::mutex> lock( mutex );
+
+        auto it = entries.find( path );
+        if ( it != entries.end() && it->second.same( st ) ) {
+            return it->second.script;
+        }
+
+        std::ifstream file( path );
+        if ( !file.good() ) return nullptr;
+
+        entry e{st.st_dev, st.st_ino, st.st_size, mtime( st ),
+                parsed::read( file )};
+        entries[path] = e;
+        return e.script;
+    }
+
+   private:
+    struct entry {
+        dev_t           dev;
+        ino_t           ino;
+        off_t           size;
+        struct timespec mtime;
+
+        std::shared_ptr<const parsed> script;
+
+        bool same( const struct stat& st ) const {
+            auto t = script::mtime( st );
+            return dev == st.st_dev && ino == st.st_ino &&
+                   size == st.st_size && mtime.tv_sec == t.tv_sec &&
+                   mtime.tv_nsec == t.tv_nsec;
+        }
+    };
+};
+}
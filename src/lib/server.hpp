@@ -1,20 +1,27 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <boost/asio.hpp>
+#include <boost/asio/bind_executor.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/lexical_cast.hpp>
 #include <deque>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "frames.hpp"
 #include "package.hpp"
+#include "slot.hpp"
 
 namespace network {
 
@@ -34,11 +41,44 @@ class _session {
     virtual void send( package_ptr message )  = 0;
     virtual const string get_client_s() const = 0;
 
+    /*
+     * drained
+     * f( true ) once fewer than Package::high_water bytes wait to be sent
+     * to this session, f( false ) when it has left
+     */
+    virtual void drained( std::function<void( bool )> f ) {
+        f( true );
+    }
+
     virtual bool operator==( const _session& other ) {
         return true;
     }
 
-    std::string hostname;
+    // run f on the thread of the session, after what it runs already
+    virtual void post( std::function<void()> f ) {
+        f();
+    }
+
+    // set by reg on the thread of the session, read by any
+    std::string hostname() const {
+        std::lock_guard<std::mutex> lock( _hostname_mutex );
+        return _hostname;
+    }
+
+    void set_hostname( std::string hostname ) {
+        std::lock_guard<std::mutex> lock( _hostname_mutex );
+        _hostname = std::move( hostname );
+    }
+
+    // words defined by the lines of this session, for no other
+    slot words;
+
+    // order of the results of the commands it runs
+    slot commands;
+
+   private:
+    mutable std::mutex _hostname_mutex;
+    std::string        _hostname;
 };
 
 typedef std::shared_ptr<_session> session_ptr;
@@ -54,11 +94,24 @@ class _Server {
     virtual void broadcast( package_ptr,
                             std::function<bool( session_ptr )> ) = 0;
     virtual void sent_to( package_ptr message, std::string hostname ) = 0;
-    virtual std::set<session_ptr>& get_clients() = 0;
+
+    // copy of the sessions, they may come and go while it is used
+    virtual std::set<session_ptr> get_clients() = 0;
+
+    // run f on a network thread
+    virtual void post( std::function<void()> f ) {
+        f();
+    }
 };
 
 typedef std::shared_ptr<_Server> server_ptr;
 
+/*
+ * session
+ * connection to a client. the io_service may run on many threads, every
+ * handler of a session goes through its strand, so that they run one at
+ * a time and send_queue needs no lock
+ */
 class session : public _session, public std::enable_shared_from_this<session> {
    public:
     session( const session& ) = delete;
@@ -67,25 +120,49 @@ class session : public _session, public std::enable_shared_from_this<session> {
     session& operator=( session&& ) noexcept = delete;
 
     session( tcp::socket socket, server_ptr server )
-        : _socket( std::move( socket ) ), _server( server ){};
+        : _socket( std::move( socket ) ),
+          _strand( _socket.get_executor() ),
+          _server( server ),
+          client_s( address( _socket ) ){};
     ~session(){};
 
     void start() {
-        client_s =
-            boost::lexical_cast<std::string>( _socket.remote_endpoint() );
         prompt( "connect" );
-        read_header();
+        read();
     };
 
-    // send message to this session
+    // send message to this session, from any thread
     void send( package_ptr package ) {
-        bool write_in_progress = !send_queue.empty();
-        send_queue.push_back( package );
-        if ( !write_in_progress ) {
-            write();
-        }
+        auto self( shared_from_this() );
+        boost::asio::post( _strand, [this, self, package]() {
+            bool write_in_progress = !send_queue.empty();
+            send_queue.push_back( package );
+            queued += package->length();
+            if ( !write_in_progress ) {
+                write();
+            }
+        } );
     };
 
+    // f runs on the strand of the session
+    void drained( std::function<void( bool )> f ) {
+        auto self( shared_from_this() );
+        boost::asio::post( _strand, [this, self, f]() {
+            if ( lost )
+                f( false );
+            else if ( queued < Package::high_water )
+                f( true );
+            else
+                waiting.push_back( f );
+        } );
+    }
+
+    // f runs on the strand of the session
+    void post( std::function<void()> f ) {
+        auto self( shared_from_this() );
+        boost::asio::post( _strand, [self, f]() { f(); } );
+    }
+
     bool operator==( const session& other ) {
         return !( this->client_s.compare( other.get_client_s() ) );
     }
@@ -94,82 +171,127 @@ class session : public _session, public std::enable_shared_from_this<session> {
         return client_s;
     }
 
-    std::string hostname;
-
    private:
+    typedef boost::asio::strand<tcp::socket::executor_type> strand;
+
+    /*
+     * address
+     * of the peer, set before the session is in the set of the server and
+     * read from any thread. empty when the peer has gone already, the
+     * first read then fails
+     */
+    static std::string address( const tcp::socket& socket ) {
+        boost::system::error_code ec;
+        auto                      remote = socket.remote_endpoint( ec );
+        if ( ec ) return std::string();
+        return boost::lexical_cast<std::string>( remote );
+    }
+
     void prompt( const string& msg ) {
 #ifdef DEBUG
         std::cout << "[" << client_s << "] " << msg << std::endl;
 #endif
     }
 
-    void read_header() {
-        recv_package = std::make_shared<Package>();
-        boost::asio::async_read(
-            _socket,
-            boost::asio::buffer( recv_package->data(), Package::header_len() ),
-            [this]( boost::system::error_code ec, std::size_t /*length*/ ) {
-                if ( !ec && recv_package->decrypt() ) {
-                    read_body();
-                } else {
-                    prompt( "leave" );
-                    _server->apply( "client_leave", shared_from_this(), NULL );
-                    _server->leave( shared_from_this() );
-                }
-            } );
+    // handler f run on the strand
+    template <typename F>
+    boost::asio::executor_binder<F, strand> on_strand( F f ) {
+        return boost::asio::bind_executor( _strand, std::move( f ) );
+    }
+
+    // as much as the socket has, then every package complete in it
+    void read() {
+        auto self( shared_from_this() );
+        _socket.async_read_some(
+            _frames.space(), on_strand( [this, self](
+                                 boost::system::error_code ec,
+                                 std::size_t               len ) {
+                if ( ec ) return fail();
+                prompt( "recv " + std::to_string( len ) + " bytes." );
+                _frames.filled( len );
+                take();
+            } ) );
     }
 
-    void read_body() {
+    void take() {
+        while ( auto package = _frames.next() ) received( package );
+        if ( _frames.broken() ) return fail();
+        if ( !_frames.straight() ) return read();
+
         auto self( shared_from_this() );
         boost::asio::async_read(
-            _socket, boost::asio::buffer( recv_package->body(),
-                                          recv_package->body_length() ),
-            [this, self]( boost::system::error_code ec, std::size_t len ) {
+            _socket, _frames.rest(),
+            on_strand( [this, self]( boost::system::error_code ec,
+                                     std::size_t len ) {
                 prompt( "recv " + std::to_string( len ) + " bytes." );
-                recv_package->try_close_file();
-                if ( !ec ) {
-                    if ( recv_package->is_command() ) {
-                        _server->apply( "recv_package", shared_from_this(),
-                                        recv_package );
-                    } else if ( recv_package->is_file() ) {
-                    }
-                    read_header();
-                } else {
-                    prompt( "leave" );
-                    _server->apply( "client_leave", shared_from_this(), NULL );
-                    _server->leave( shared_from_this() );
-                }
-            } );
-    };
+                auto package = _frames.finish();
+                package->try_close_file();
+                if ( ec ) return fail();
+                received( package );
+                read();
+            } ) );
+    }
+
+    void received( package_ptr package ) {
+        package->try_close_file();
+        if ( package->is_command() ) {
+            _server->apply( "recv_package", shared_from_this(), package );
+        }
+    }
 
+    // every package waiting, up to gather::max_bytes, in one call
     void write() {
         auto self( shared_from_this() );
-        send_queue.front()->encrypt();
         boost::asio::async_write(
-            _socket, boost::asio::buffer( send_queue.front()->data(),
-                                          send_queue.front()->length() ),
-            [this, self]( boost::system::error_code ec, std::size_t len ) {
+            _socket, _gather.take( send_queue ), &gather::counted,
+            on_strand( [this, self]( boost::system::error_code ec,
+                                     std::size_t len ) {
                 prompt( "sent " + std::to_string( len ) + " bytes." );
                 if ( !ec ) {
-                    send_queue.pop_front();
+                    queued -= _gather.bytes();
+                    send_queue.erase(
+                        send_queue.begin(),
+                        send_queue.begin() + _gather.packages() );
+                    if ( queued < Package::high_water ) release();
                     if ( !send_queue.empty() ) {
                         write();
                     }
                 } else {
-                    prompt( "leave" );
-                    _server->apply( "client_leave", shared_from_this(), NULL );
-                    _server->leave( shared_from_this() );
+                    fail();
                 }
-            } );
+            } ) );
     };
 
+    // leave the server, once however many handlers fail
+    void fail() {
+        if ( lost ) return;
+        prompt( "leave" );
+        lost = true;
+        release();
+        _server->apply( "client_leave", shared_from_this(), NULL );
+        _server->leave( shared_from_this() );
+    }
+
+    // run the callbacks waiting in drained
+    void release() {
+        auto w = std::move( waiting );
+        waiting.clear();
+        for ( auto& f : w ) f( !lost );
+    }
+
     tcp::socket _socket;
+    strand      _strand;
     server_ptr  _server;
     std::string client_s;
 
     deque<package_ptr> send_queue;
+    std::size_t        queued = 0;  // bytes in send_queue
+    bool               lost   = false;
 
-    package_ptr recv_package;
+    vector<std::function<void( bool )> > waiting;
+
+    frames _frames;
+    gather _gather;
 };
 
 class Server : public _Server, public std::enable_shared_from_this<Server> {
@@ -180,12 +302,35 @@ class Server : public _Server, public std::enable_shared_from_this<Server> {
     Server& operator=( Server&& ) noexcept = delete;
 
     Server( boost::asio::io_service& io_service, const tcp::endpoint& endpoint )
-        : _acceptor( io_service, endpoint ), _socket( io_service ){};
+        : Server( std::vector<boost::asio::io_service*>{&io_service},
+                  endpoint ){};
+
+    /*
+     * Server
+     * one acceptor on each io_service. more than one are bound to the same
+     * port with SO_REUSEPORT, the kernel spreads new connections between
+     * them so a storm of reconnects is not queued behind a single accept
+     */
+    Server( const std::vector<boost::asio::io_service*>& services,
+            const tcp::endpoint&                         endpoint ) {
+        for ( auto io : services ) {
+            std::unique_ptr<listener> l( new listener( *io ) );
+            l->acceptor.open( endpoint.protocol() );
+            l->acceptor.set_option( tcp::acceptor::reuse_address( true ) );
+            if ( services.size() > 1 )
+                l->acceptor.set_option( reuse_port( true ) );
+            l->acceptor.bind( endpoint );
+            l->acceptor.listen( SOMAXCONN );
+            // for the connections taken along with the one accepted
+            l->acceptor.non_blocking( true );
+            _listeners.push_back( std::move( l ) );
+        }
+    };
     ~Server(){};
 
     // start server
     void start() {
-        accept();
+        for ( auto& l : _listeners ) accept( *l );
 
         std::cout << "Server is listening on "
                   << "8888" << std::endl;
@@ -193,24 +338,33 @@ class Server : public _Server, public std::enable_shared_from_this<Server> {
 
     void sent_to( package_ptr message, std::string hostname ) {
         broadcast( message, [&]( session_ptr session ) {
-            return session->hostname == hostname;
+            return session->hostname() == hostname;
         } );
     }
 
     void broadcast( package_ptr                        message,
                     std::function<bool( session_ptr )> filter ) {
-        for ( auto it = _clients.begin(); it != _clients.end(); ++it ) {
-            if ( filter( *it ) ) ( *it )->send( message );
+        for ( auto& c : get_clients() ) {
+            if ( filter( c ) ) c->send( message );
         }
     };
 
+    /*
+     * on
+     * the list of handlers is copied on change, apply runs on the copy it
+     * finds without a lock
+     */
     void on( string event,
              std::function<void( package_ptr, session_ptr, server_ptr )> fn ) {
-        _el.push_back( make_pair( event, fn ) );
+        std::lock_guard<std::mutex> lock( _el_mutex );
+        auto el = std::make_shared<handlers>( *std::atomic_load( &_el ) );
+        el->push_back( make_pair( event, fn ) );
+        std::atomic_store( &_el, std::shared_ptr<const handlers>( el ) );
     };
 
     void apply( string event, session_ptr session, package_ptr msg ) {
-        for ( auto e : _el ) {
+        auto el = std::atomic_load( &_el );
+        for ( auto& e : *el ) {
             if ( e.first == event ) {
                 ( e.second )( msg, session, shared_from_this() );
             }
@@ -218,7 +372,11 @@ class Server : public _Server, public std::enable_shared_from_this<Server> {
     };
 
     void leave( session_ptr cptr ) {
+        std::lock_guard<std::mutex> lock( _clients_mutex );
+
+        // a session kept alive by a pending reply may fail more than once
         auto it = _clients.find( cptr );
+        if ( it == _clients.end() ) return;
         _clients.erase( it );
 
 #ifdef DEBUG
@@ -226,36 +384,75 @@ class Server : public _Server, public std::enable_shared_from_this<Server> {
 #endif
     }
 
-    virtual std::set<session_ptr>& get_clients() {
+    std::set<session_ptr> get_clients() {
+        std::lock_guard<std::mutex> lock( _clients_mutex );
         return _clients;
     }
 
+    void post( std::function<void()> f ) {
+        boost::asio::post( _listeners.front()->acceptor.get_executor(),
+                           std::move( f ) );
+    }
+
    private:
-    void accept() {
-        _acceptor.async_accept(
-            _socket, [this]( boost::system::error_code ec ) {
+    typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,
+                                                        SO_REUSEPORT>
+        reuse_port;
+
+    struct listener {
+        explicit listener( boost::asio::io_service& io_service )
+            : acceptor( io_service ), socket( io_service ) {}
+
+        tcp::acceptor acceptor;
+        tcp::socket   socket;
+    };
+
+    // most connections taken from the backlog per accept
+    enum { accept_batch = 64 };
+
+    void accept( listener& l ) {
+        l.acceptor.async_accept(
+            l.socket, [this, &l]( boost::system::error_code ec ) {
                 if ( !ec ) {
-                    auto ptr = std::make_shared<session>( std::move( _socket ),
-                                                          shared_from_this() );
-                    _clients.insert( ptr );
+                    // the ones already waiting come along without a round
+                    // through the io_service, and the set is locked once
+                    std::vector<std::shared_ptr<session> > batch;
+                    for ( ;; ) {
+                        auto ptr = std::make_shared<session>(
+                            std::move( l.socket ), shared_from_this() );
+                        batch.push_back( ptr );
+                        if ( batch.size() == accept_batch ) break;
+                        boost::system::error_code again;
+                        l.acceptor.accept( l.socket, again );
+                        if ( again ) break;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock( _clients_mutex );
+                        _clients.insert( batch.begin(), batch.end() );
 #ifdef DEBUG
-                    std::cout << "[server] client = " << _clients.size()
-                              << std::endl;
+                        std::cout << "[server] client = " << _clients.size()
+                                  << std::endl;
 #endif
-                    ptr->start();
+                    }
+                    // complete since their constructor, so they are in the
+                    // set before a package of theirs can make them leave
+                    for ( auto& ptr : batch ) ptr->start();
                 }
 
-                accept();
+                accept( l );
             } );
     };
 
-    tcp::acceptor _acceptor;
-    tcp::socket   _socket;
+    std::vector<std::unique_ptr<listener> > _listeners;
 
+    std::mutex            _clients_mutex;
     std::set<session_ptr> _clients;
 
-    vector<pair<string,
-                std::function<void( package_ptr, session_ptr, server_ptr )> > >
-        _el;
+    typedef vector<pair<
+        string, std::function<void( package_ptr, session_ptr, server_ptr )> > >
+        handlers;
+
+    std::mutex                      _el_mutex;
+    std::shared_ptr<const handlers> _el = std::make_shared<handlers>();
 };
 }
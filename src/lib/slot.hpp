@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+namespace network {
+
+/*
+ * slot
+ * state the interpreter keeps for one link, made on first use. the link
+ * holds it without knowing its type, T is always the same for a slot
+ */
+class slot {
+   public:
+    template <typename T>
+    std::shared_ptr<T> get() {
+        std::lock_guard<std::mutex> lock( _mutex );
+        if ( !_state ) _state = std::make_shared<T>();
+        return std::static_pointer_cast<T>( _state );
+    }
+
+   private:
+    std::mutex            _mutex;
+    std::shared_ptr<void> _state;
+};
+}
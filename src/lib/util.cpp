@@ -1,77 +1,159 @@
 #include "util.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <stdexcept>
 #include <vector>
 
+extern char** environ;
+
 namespace util {
 
 using namespace std::chrono;
 
-std::string exec( const char* cmd, bool to_stdout ) {
-    char        buffer[MAXPIPELEN];
-    std::string result = "";
-    FILE*       pipe   = popen( cmd, "r" );
-    if ( !pipe ) throw std::runtime_error( "popen() failed!" );
-    try {
-        while ( !feof( pipe ) ) {
-            if ( fgets( buffer, MAXPIPELEN, pipe ) != NULL ) {
-                result += buffer;
-                if ( to_stdout ) {
-                    cout << buffer;
-                }
-            }
-        }
-    } catch ( ... ) {
-        pclose( pipe );
-        throw;
+static uint64_t steady_now() {
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() )
+        .count();
+}
+
+process spawn( const vector<string>& argv ) {
+    if ( argv.empty() ) throw std::runtime_error( "spawn() of nothing!" );
+
+    int fds[2];
+    if ( pipe2( fds, O_CLOEXEC ) != 0 )
+        throw std::runtime_error( "pipe() failed!" );
+#ifdef F_SETPIPE_SZ
+    // room for a whole chunk, so the command is not woken for every page
+    fcntl( fds[0], F_SETPIPE_SZ, MAXSTREAMCHUNK );
+#endif
+
+    // only the copy on stdout is left open in the child
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init( &actions );
+    posix_spawn_file_actions_adddup2( &actions, fds[1], STDOUT_FILENO );
+
+    // a group of its own, what it starts is stopped along with it
+    posix_spawnattr_t attr;
+    posix_spawnattr_init( &attr );
+    posix_spawnattr_setflags( &attr, POSIX_SPAWN_SETPGROUP );
+    posix_spawnattr_setpgroup( &attr, 0 );
+
+    vector<char*> args;
+    for ( auto& a : argv ) args.push_back( const_cast<char*>( a.c_str() ) );
+    args.push_back( nullptr );
+
+    process p{-1, fds[0], steady_now()};
+    int err = posix_spawnp( &p.pid, args[0], &actions, &attr, args.data(),
+                            environ );
+    posix_spawnattr_destroy( &attr );
+    posix_spawn_file_actions_destroy( &actions );
+    close( fds[1] );
+    if ( err != 0 ) {
+        close( fds[0] );
+        throw std::runtime_error( "cannot run " + argv[0] + ": " +
+                                  std::strerror( err ) );
     }
-    pclose( pipe );
-    return result;
+    return p;
 }
 
-double diffclock( clock_t clock1, clock_t clock2 ) {
-    double diffticks = clock1 - clock2;
-    double diffms    = diffticks / ( CLOCKS_PER_SEC / 1000 );
+static int64_t micros( const timeval& t ) {
+    return static_cast<int64_t>( t.tv_sec ) * 1000000 + t.tv_usec;
+}
 
-    return diffms;
+usage wait( process& p ) {
+    if ( p.out >= 0 ) close( p.out );
+    p.out = -1;
+
+    int    status = 0;
+    rusage r;
+    std::memset( &r, 0, sizeof( r ) );
+    while ( wait4( p.pid, &status, 0, &r ) < 0 && errno == EINTR ) {
+    }
+
+    usage u;
+    u.exit      = WIFSIGNALED( status ) ? 128 + WTERMSIG( status )
+                                        : WEXITSTATUS( status );
+    u.user_us   = micros( r.ru_utime );
+    u.sys_us    = micros( r.ru_stime );
+    u.maxrss_kb = r.ru_maxrss;
+    u.minflt    = r.ru_minflt;
+    u.majflt    = r.ru_majflt;
+    u.nvcsw     = r.ru_nvcsw;
+    u.nivcsw    = r.ru_nivcsw;
+    u.wall_us   = ( steady_now() - p.started ) / 1000;
+    return u;
 }
 
-pair<std::string, double> exec_timer( const char* cmd, bool to_stdout ) {
-    char        buffer[MAXPIPELEN];
-    std::string result = "";
+vector<string> shell( const std::string& cmd ) {
+    return {"/bin/sh", "-c", cmd};
+}
 
-    using Clock = std::chrono::high_resolution_clock;
+std::string exec( const vector<string>& argv, bool to_stdout,
+                  usage* used ) {
+    std::string result;
+    auto        u = exec_stream( argv, [&]( boost::string_view chunk ) {
+        result.append( chunk.data(), chunk.size() );
+        if ( to_stdout ) cout << chunk;
+        return true;
+    } );
+    if ( used ) *used = u;
+    return result;
+}
+
+std::string exec( const char* cmd, bool to_stdout, usage* used ) {
+    return exec( shell( cmd ), to_stdout, used );
+}
 
-    double t_start = Clock::now().time_since_epoch().count();
+usage exec_stream( const vector<string>&                            argv,
+                   const std::function<bool( boost::string_view )>& sink ) {
+    auto p = spawn( argv );
 
-    FILE* pipe = popen( cmd, "r" );
-    if ( !pipe ) throw std::runtime_error( "popen() failed!" );
+    // read the pipe itself, not through stdio, to get bytes as they come
+    std::unique_ptr<char[]> buffer( new char[MAXSTREAMCHUNK] );
     try {
-        while ( !feof( pipe ) ) {
-            if ( fgets( buffer, MAXPIPELEN, pipe ) != NULL ) {
-                result += buffer;
-                if ( to_stdout ) {
-                    cout << buffer;
-                }
+        for ( ;; ) {
+            auto n = read( p.out, buffer.get(), MAXSTREAMCHUNK );
+            if ( n < 0 && errno == EINTR ) continue;
+            if ( n <= 0 ) break;
+            if ( !sink( boost::string_view( buffer.get(), n ) ) ) {
+                // a quiet command would never see that the pipe is closed,
+                // nor would the rest of a pipeline
+                kill( -p.pid, SIGTERM );
+                break;
             }
         }
     } catch ( ... ) {
-        pclose( pipe );
+        kill( -p.pid, SIGTERM );
+        wait( p );
         throw;
     }
-    double value = pclose( pipe );
+    return wait( p );
+}
 
-    double t_end = Clock::now().time_since_epoch().count();
+double diffclock( clock_t clock1, clock_t clock2 ) {
+    double diffticks = clock1 - clock2;
+    double diffms    = diffticks / ( CLOCKS_PER_SEC / 1000 );
 
-    return pair<std::string, double>( result, t_end - t_start );
+    return diffms;
+}
+
+pair<std::string, double> exec_timer( const char* cmd, bool to_stdout ) {
+    usage u;
+    auto  result = exec( cmd, to_stdout, &u );
+    return pair<std::string, double>( result, u.wall_us * 1000.0 );
 }
 
 std::string get_time() {
@@ -94,6 +176,26 @@ vector<string> split( string str, char delimiter ) {
     return internal;
 }
 
+/*
+ * split_view
+ * same tokens as split, found with memchr (vectorized in libc)
+ */
+void split_view( boost::string_view str, char delimiter, views& out ) {
+    const char* data = str.data();
+    std::size_t n    = str.size();
+    std::size_t from = 0;
+    while ( from < n ) {
+        auto p = static_cast<const char*>(
+            std::memchr( data + from, delimiter, n - from ) );
+        if ( !p ) {
+            out.emplace_back( data + from, n - from );
+            break;
+        }
+        out.emplace_back( data + from, p - data - from );
+        from = p - data + 1;
+    }
+}
+
 // From Monad
 void assertExists( const string& path, int exit_code /* = -1 */ ) {
     if ( !exists( path ) ) {
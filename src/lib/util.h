@@ -14,21 +14,86 @@
 #include <unistd.h>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include <boost/container/small_vector.hpp>
+#include <boost/utility/string_view.hpp>
+
 namespace util {
 using namespace std;
 
 #define MAXPIPELEN 4096
-std::string exec( const char* cmd, bool to_stdout );
+
+/*
+ * process
+ * child started by spawn, its stdout is read from out
+ */
+struct process {
+    pid_t    pid;
+    int      out;
+    uint64_t started;  // steady clock, nanoseconds
+};
+
+/*
+ * usage
+ * what a child cost, from wait4. exit is its exit code, or 128 plus the
+ * signal that killed it as the shell has it
+ */
+struct usage {
+    int     exit      = 0;
+    int64_t user_us   = 0;  // CPU time in user mode
+    int64_t sys_us    = 0;  // CPU time in the kernel
+    int64_t maxrss_kb = 0;
+    int64_t minflt    = 0;  // page faults without I/O
+    int64_t majflt    = 0;  // page faults with I/O
+    int64_t nvcsw     = 0;  // voluntary context switches
+    int64_t nivcsw    = 0;  // involuntary context switches
+    int64_t wall_us   = 0;  // from spawn to exit
+};
+
+/*
+ * spawn
+ * start argv[0], looked up in PATH, with argv as it is and no shell in
+ * between. posix_spawn starts the child without copying the page tables
+ * of the agent as fork does, however much it has mapped. the child leads
+ * a process group of its own, whose id is its pid
+ */
+process spawn( const vector<string>& argv );
+
+// close the pipe of p and wait for it
+usage wait( process& p );
+
+// argv running cmd by /bin/sh, for commands with pipes, globs, etc.
+vector<string> shell( const std::string& cmd );
+
+std::string exec( const vector<string>& argv, bool to_stdout,
+                  usage* used = nullptr );
+std::string exec( const char* cmd, bool to_stdout, usage* used = nullptr );
+
+// output and wall time in nanoseconds
 pair<std::string, double> exec_timer( const char* cmd, bool to_stdout );
 
+/*
+ * exec_stream
+ * run argv and hand its output to sink as it comes, at most MAXSTREAMCHUNK
+ * bytes at a time. sink returns false to stop reading, the process group
+ * of the command is then sent SIGTERM and the command waited for
+ */
+#define MAXSTREAMCHUNK 65536
+usage exec_stream( const vector<string>&                            argv,
+                   const std::function<bool( boost::string_view )>& sink );
+
 vector<string> split( string str, char delimiter );
 
+// tokens pointing into the splitted string, no copy
+typedef boost::container::small_vector<boost::string_view, 32> views;
+void split_view( boost::string_view str, char delimiter, views& out );
+
 void assertExists( const string& path, int exit_code = -1 );
 bool exists( const string& path );
 mode_t permissions( const string& path );
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <boost/container/pmr/polymorphic_allocator.hpp>
+#include <boost/container/pmr/string.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "buffer.hpp"
+
+namespace bytecode {
+
+/*
+ * value
+ * element of vstack, numbers are kept as numbers and only formatted
+ * when the value is printed or packed
+ *
+ * short text lives in a polymorphic allocator, a container with a memory
+ * resource (see arena.hpp) constructs its values there. a plain copy goes
+ * back to the default resource, so only moves keep the memory of origin
+ *
+ * long text lives in a buffer shared by all copies of the value, so
+ * passing it around never copies the bytes. append and prepend write into
+ * the buffer only while this value is its one owner
+ *
+ * a MARK bounds a segment of vstack, its text is "mark" so that packed as
+ * text it reads back as the word pushing it
+ */
+class value {
+   public:
+    enum kind : std::uint8_t { INT, REAL, STRING, BLOB, MARK };
+
+    // text from this length on goes to a shared buffer
+    enum { share_min = 256 };
+
+    typedef boost::container::pmr::polymorphic_allocator<char> allocator_type;
+    typedef boost::container::allocator_arg_t                  allocator_arg_t;
+
+    value() : _kind( STRING ), _int( 0 ) {}
+    value( const std::string& s ) : _kind( STRING ), _int( 0 ) {
+        assign( s );
+    }
+    value( std::string&& s ) : _kind( STRING ), _int( 0 ) {
+        assign( std::move( s ) );
+    }
+    value( const char* s ) : _kind( STRING ), _int( 0 ) {
+        assign( boost::string_view( s ) );
+    }
+    explicit value( boost::string_view s ) : _kind( STRING ), _int( 0 ) {
+        assign( s );
+    }
+
+    // text of kind STRING or BLOB
+    value( kind k, boost::string_view s ) : _kind( k ), _int( 0 ) {
+        assign( s );
+    }
+
+    value( allocator_arg_t, const allocator_type& a )
+        : _kind( STRING ), _int( 0 ), _text( a ) {}
+    value( allocator_arg_t, const allocator_type& a, boost::string_view s )
+        : _kind( STRING ), _int( 0 ), _text( a ) {
+        assign( s );
+    }
+    value( allocator_arg_t, const allocator_type& a, kind k,
+           boost::string_view s )
+        : _kind( k ), _int( 0 ), _text( a ) {
+        assign( s );
+    }
+    value( allocator_arg_t, const allocator_type& a, const value& v )
+        : _kind( v._kind ),
+          _text( v._text.data(), v._text.size(), a ),
+          _shared( v._shared ) {
+        copy_number( v );
+    }
+    value( allocator_arg_t, const allocator_type& a, value&& v )
+        : _kind( v._kind ),
+          _text( std::move( v._text ), a ),
+          _shared( std::move( v._shared ) ) {
+        copy_number( v );
+    }
+    template <typename T>
+    value( allocator_arg_t, const allocator_type& a, T&& x )
+        : value( boost::container::allocator_arg, a,
+                 value( std::forward<T>( x ) ) ) {}
+
+    static value integer( std::int64_t i ) {
+        value v;
+        v._kind = INT;
+        v._int  = i;
+        return v;
+    }
+
+    static value real( double d ) {
+        value v;
+        v._kind = REAL;
+        v._real = d;
+        return v;
+    }
+
+    static value blob( std::string s ) {
+        value v( std::move( s ) );
+        v._kind = BLOB;
+        return v;
+    }
+
+    static value mark() {
+        return value( MARK, "mark" );
+    }
+
+    /*
+     * literal
+     * token from a line, integers written in canonical form become numbers
+     * since formatting them gives back the same text
+     */
+    static value literal( boost::string_view     token,
+                          const allocator_type& a = allocator_type() ) {
+        auto i = canonical( token );
+        if ( i.first ) return integer( i.second );
+        return value( boost::container::allocator_arg, a, token );
+    }
+
+    kind type() const {
+        return _kind;
+    }
+
+    bool is_number() const {
+        return _kind == INT || _kind == REAL;
+    }
+
+    /*
+     * view
+     * bytes of a STRING or BLOB, valid until the value is changed
+     */
+    boost::string_view view() const {
+        if ( _shared ) return _shared->view();
+        return boost::string_view( _text.data(), _text.size() );
+    }
+
+    /*
+     * text
+     * bytes of any kind, a number is formatted into scratch
+     */
+    boost::string_view text( std::string& scratch ) const {
+        if ( !is_number() ) return view();
+        scratch = str();
+        return scratch;
+    }
+
+    /*
+     * write
+     * append the text of the value to out, without a temporary for text
+     */
+    void write( std::string& out ) const {
+        if ( is_number() ) {
+            out += str();
+        } else {
+            auto v = view();
+            out.append( v.data(), v.size() );
+        }
+    }
+
+    /*
+     * append / prepend
+     * concatenate as text, the result is a STRING
+     */
+    void append( const value& v ) {
+        if ( v.is_number() )
+            grow( v.str(), false );
+        else
+            grow( v.view(), false );
+    }
+
+    void prepend( const value& v ) {
+        if ( v.is_number() )
+            grow( v.str(), true );
+        else
+            grow( v.view(), true );
+    }
+
+    /*
+     * number
+     * convert to INT or REAL for arithmatic, text that is not a number
+     * is read as std::stol does
+     */
+    value number() const {
+        if ( is_number() ) return *this;
+        if ( _shared ) return parse( str().c_str() );
+        return parse( _text.c_str() );
+    }
+
+    /*
+     * to_int
+     * lenient conversion like std::atoi, used for counts
+     */
+    std::int64_t to_int() const {
+        switch ( _kind ) {
+            case INT:
+                return _int;
+            case REAL:
+                return static_cast<std::int64_t>( _real );
+            default:
+                return _shared ? std::atoll( str().c_str() )
+                               : std::atoll( _text.c_str() );
+        }
+    }
+
+    double to_real() const {
+        switch ( _kind ) {
+            case INT:
+                return static_cast<double>( _int );
+            case REAL:
+                return _real;
+            default:
+                return number().to_real();
+        }
+    }
+
+    /*
+     * truth
+     * "0" and numbers equal to zero are false
+     */
+    bool truth() const {
+        switch ( _kind ) {
+            case INT:
+                return _int != 0;
+            case REAL:
+                return _real != 0;
+            default:
+                return view() != "0";
+        }
+    }
+
+    std::string str() const {
+        switch ( _kind ) {
+            case INT:
+                return std::to_string( _int );
+            case REAL:
+                return format( _real );
+            default:
+                return view().to_string();
+        }
+    }
+
+    bool operator==( const value& other ) const {
+        if ( is_number() && other.is_number() ) {
+            if ( _kind == INT && other._kind == INT )
+                return _int == other._int;
+            return to_real() == other.to_real();
+        }
+        if ( !is_number() && !other.is_number() )
+            return view() == other.view();
+        return str() == other.str();
+    }
+
+    bool operator!=( const value& other ) const {
+        return !( *this == other );
+    }
+
+   private:
+    typedef boost::container::pmr::string short_text;
+
+    void assign( boost::string_view s ) {
+        if ( s.size() >= share_min )
+            _shared = std::make_shared<buffer>( s, 0, 0 );
+        else
+            _text.assign( s.data(), s.size() );
+    }
+
+    void assign( std::string&& s ) {
+        if ( s.size() >= share_min )
+            _shared = std::make_shared<buffer>( std::move( s ) );
+        else
+            _text.assign( s.data(), s.size() );
+    }
+
+    void grow( boost::string_view s, bool front ) {
+        if ( is_number() ) {
+            auto t = str();
+            _kind  = STRING;
+            _int   = 0;
+            assign( t );
+        }
+        _kind = STRING;
+
+        if ( _shared ) {
+            if ( _shared.use_count() == 1 &&
+                 ( front ? _shared->prepend( s ) : _shared->append( s ) ) )
+                return;
+            auto v  = _shared->view();
+            _shared = front ? buffer::concat( s, v ) : buffer::concat( v, s );
+        } else if ( _text.size() + s.size() < share_min ) {
+            if ( front )
+                _text.insert( _text.begin(), s.begin(), s.end() );
+            else
+                _text.append( s.begin(), s.end() );
+        } else {
+            boost::string_view v( _text.data(), _text.size() );
+            _shared = front ? buffer::concat( s, v ) : buffer::concat( v, s );
+            _text.clear();
+        }
+    }
+
+    static value parse( const char* s ) {
+        char*     end;
+        errno       = 0;
+        long long i = std::strtoll( s, &end, 10 );
+        if ( end != s && *end == '\0' && errno == 0 ) return integer( i );
+
+        if ( s[std::strspn( s, " \t\n+-.0123456789eE" )] == '\0' ) {
+            double d = std::strtod( s, &end );
+            if ( end != s && *end == '\0' ) return real( d );
+        }
+
+        return integer( std::stol( s ) );
+    }
+
+    void copy_number( const value& v ) {
+        if ( _kind == REAL )
+            _real = v._real;
+        else
+            _int = v._int;
+    }
+
+    static std::pair<bool, std::int64_t> canonical( boost::string_view s ) {
+        if ( s.empty() || s.length() > 20 ) return {false, 0};
+        std::size_t i = s[0] == '-' ? 1 : 0;
+        if ( i == s.length() ) return {false, 0};
+        if ( s[i] == '0' && s.length() > i + 1 ) return {false, 0};
+        for ( auto j = i; j < s.length(); ++j ) {
+            if ( s[j] < '0' || s[j] > '9' ) return {false, 0};
+        }
+        if ( s == "-0" ) return {false, 0};
+        char buf[24] = "";
+        s.copy( buf, s.length() );
+        errno  = 0;
+        auto n = std::strtoll( buf, nullptr, 10 );
+        if ( errno != 0 ) return {false, 0};
+        return {true, n};
+    }
+
+    // shortest text that reads back the same double
+    static std::string format( double d ) {
+        char buf[32];
+        std::snprintf( buf, sizeof( buf ), "%.15g", d );
+        if ( std::strtod( buf, nullptr ) != d )
+            std::snprintf( buf, sizeof( buf ), "%.17g", d );
+        return buf;
+    }
+
+    kind _kind;
+    union {
+        std::int64_t _int;
+        double       _real;
+    };
+    short_text      _text;
+    buffer::pointer _shared;
+};
+}
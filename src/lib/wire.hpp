@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <boost/utility/string_view.hpp>
+
+#include "value.hpp"
+
+namespace wire {
+
+using bytecode::value;
+
+/*
+ * binary stack
+ * | VERSION 1 byte | COUNT varint | TOKEN ... | COUNT varint | VALUE ... |
+ *
+ * a token is a varint length and its bytes, tokens are in line order.
+ * a value is its kind in one byte, then a zigzag varint for INT, 8 bytes
+ * little endian for REAL, or a varint length and the bytes for STRING,
+ * BLOB and MARK. values go from the bottom of vstack to the top
+ */
+enum { version = 1 };
+
+inline void put_varint( std::string& out, std::uint64_t n ) {
+    while ( n >= 0x80 ) {
+        out += static_cast<char>( n | 0x80 );
+        n >>= 7;
+    }
+    out += static_cast<char>( n );
+}
+
+inline bool get_varint( const char*& p, const char* end, std::uint64_t& n ) {
+    n = 0;
+    for ( unsigned shift = 0; shift < 64 && p < end; shift += 7 ) {
+        auto b = static_cast<std::uint8_t>( *p++ );
+        n |= static_cast<std::uint64_t>( b & 0x7f ) << shift;
+        if ( !( b & 0x80 ) ) return true;
+    }
+    return false;
+}
+
+inline void put_bytes( std::string& out, boost::string_view s ) {
+    put_varint( out, s.size() );
+    out.append( s.data(), s.size() );
+}
+
+inline bool get_bytes( const char*& p, const char* end,
+                       boost::string_view& s ) {
+    std::uint64_t n;
+    if ( !get_varint( p, end, n ) ) return false;
+    if ( n > static_cast<std::uint64_t>( end - p ) ) return false;
+    s = boost::string_view( p, n );
+    p += n;
+    return true;
+}
+
+/*
+ * encode
+ * tokens of the call stack and values of vstack, one pass over each
+ */
+template <typename Tokens, typename Values>
+std::string encode( const Tokens& tokens, const Values& values ) {
+    std::string out;
+    out += static_cast<char>( version );
+
+    put_varint( out, tokens.size() );
+    for ( auto& t : tokens ) put_bytes( out, t );
+
+    put_varint( out, values.size() );
+    for ( auto& v : values ) {
+        out += static_cast<char>( v.type() );
+        switch ( v.type() ) {
+            case value::INT: {
+                auto i = v.to_int();
+                put_varint( out, static_cast<std::uint64_t>( i ) << 1 ^
+                                     static_cast<std::uint64_t>( i >> 63 ) );
+                break;
+            }
+            case value::REAL: {
+                double        d = v.to_real();
+                std::uint64_t bits;
+                std::memcpy( &bits, &d, sizeof( bits ) );
+                for ( int i = 0; i < 8; ++i, bits >>= 8 ) {
+                    out += static_cast<char>( bits & 0xff );
+                }
+                break;
+            }
+            default:
+                put_bytes( out, v.view() );
+        }
+    }
+    return out;
+}
+
+/*
+ * decode
+ * tokens are views into data, values are constructed in place so that an
+ * allocator aware container keeps them in its own memory
+ */
+template <typename Tokens, typename Values>
+bool decode( boost::string_view data, Tokens& tokens, Values& values ) {
+    const char* p   = data.data();
+    const char* end = p + data.size();
+
+    if ( p == end || static_cast<std::uint8_t>( *p++ ) != version )
+        return false;
+
+    std::uint64_t      n;
+    boost::string_view s;
+
+    if ( !get_varint( p, end, n ) ) return false;
+    while ( n-- > 0 ) {
+        if ( !get_bytes( p, end, s ) ) return false;
+        tokens.push_back( s );
+    }
+
+    if ( !get_varint( p, end, n ) ) return false;
+    while ( n-- > 0 ) {
+        if ( p == end ) return false;
+        auto kind = static_cast<value::kind>( *p++ );
+        switch ( kind ) {
+            case value::INT: {
+                std::uint64_t z;
+                if ( !get_varint( p, end, z ) ) return false;
+                auto i = static_cast<std::int64_t>( z >> 1 ) ^
+                         -static_cast<std::int64_t>( z & 1 );
+                values.emplace_back( value::integer( i ) );
+                break;
+            }
+            case value::REAL: {
+                if ( end - p < 8 ) return false;
+                std::uint64_t bits = 0;
+                for ( int i = 7; i >= 0; --i ) {
+                    bits = bits << 8 | static_cast<std::uint8_t>( p[i] );
+                }
+                p += 8;
+                double d;
+                std::memcpy( &d, &bits, sizeof( d ) );
+                values.emplace_back( value::real( d ) );
+                break;
+            }
+            case value::STRING:
+            case value::BLOB:
+            case value::MARK:
+                if ( !get_bytes( p, end, s ) ) return false;
+                values.emplace_back( kind, s );
+                break;
+            default:
+                return false;
+        }
+    }
+    return p == end;
+}
+}
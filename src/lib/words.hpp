@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace words {
+
+/*
+ * perfect hash
+ * the seed is searched at compile time so that every name of a fixed table
+ * falls into its own slot, a lookup is one hash and one string compare
+ */
+enum { slots = 256 };
+
+constexpr std::uint32_t hash( const char* s, std::size_t n,
+                              std::uint32_t seed ) {
+    std::uint32_t h = 2166136261u ^ seed;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        h ^= static_cast<std::uint8_t>( s[i] );
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    return h & ( slots - 1 );
+}
+
+constexpr std::size_t length( const char* s ) {
+    std::size_t n = 0;
+    while ( s[n] ) ++n;
+    return n;
+}
+
+template <typename Fn>
+struct entry {
+    const char* name;
+    Fn          fn;
+};
+
+/*
+ * index
+ * slot holds position in table plus one, zero for empty slot
+ */
+struct index {
+    std::uint32_t seed;
+    std::uint8_t  slot[slots];
+};
+
+template <typename Fn, std::size_t N>
+constexpr index build( const entry<Fn> ( &table )[N] ) {
+    static_assert( N < slots / 2, "too many words for the index" );
+    for ( std::uint32_t seed = 0;; seed += 0x9e3779b9u ) {
+        index t{seed, {}};
+        bool  ok = true;
+        for ( std::size_t i = 0; i < N && ok; ++i ) {
+            auto h = hash( table[i].name, length( table[i].name ), seed );
+            if ( t.slot[h] ) {
+                ok = false;
+            } else {
+                t.slot[h] = static_cast<std::uint8_t>( i + 1 );
+            }
+        }
+        if ( ok ) return t;
+    }
+}
+
+template <typename Fn, std::size_t N>
+const entry<Fn>* find( const entry<Fn> ( &table )[N], const index& idx,
+                       const char* s, std::size_t n ) {
+    auto i = idx.slot[hash( s, n, idx.seed )];
+    if ( !i ) return nullptr;
+    auto& e = table[i - 1];
+    if ( std::strlen( e.name ) != n || std::memcmp( e.name, s, n ) != 0 )
+        return nullptr;
+    return &e;
+}
+}
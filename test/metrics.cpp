@@ -0,0 +1,50 @@
+/*
+ * metrics
+ * parse of /proc/[pid]/stat lines. a process with no terminal has tpgid
+ * -1 and one run before others a negative nice, the fields after them
+ * must still be read
+ */
+
+#include <cstdio>
+
+#include "lib/metrics.hpp"
+
+static int failed = 0;
+
+template <typename T>
+static void expect( const char* what, T got, T want ) {
+    if ( got == want ) return;
+    std::printf( "%s: got %lld, want %lld\n", what,
+                 static_cast<long long>( got ),
+                 static_cast<long long>( want ) );
+    ++failed;
+}
+
+int main() {
+    // pid (name) state ppid pgrp session tty_nr tpgid flags minflt cminflt
+    // majflt cmajflt utime stime cutime cstime priority nice num_threads
+    // itrealvalue starttime vsize rss ...
+    const char* line =
+        "1234 (a) (b) S 1 1234 1234 0 -1 4194560 1197 0 0 0 25 13 0 0 -21 "
+        "-20 1 0 1567 23900160 3120 18446744073709551615 1 1 0 0 0 0 0 0 0 "
+        "0 0 17 0 0 0 0 0 0\n";
+
+    metrics::proc_stat s;
+    if ( !metrics::parse_stat( boost::string_view( line ), s ) ) {
+        std::printf( "stat line not parsed\n" );
+        return 1;
+    }
+    if ( s.name != "a) (b" ) {
+        std::printf( "name: got %s\n", s.name.to_string().c_str() );
+        ++failed;
+    }
+    expect( "ticks", s.ticks, std::uint64_t( 38 ) );
+    expect( "started", s.started, std::uint64_t( 1567 ) );
+    expect( "rss_pages", s.rss_pages, std::int64_t( 3120 ) );
+
+    if ( metrics::parse_stat( boost::string_view( "1234 S 1" ), s ) ) {
+        std::printf( "line without name parsed\n" );
+        ++failed;
+    }
+    return failed ? 1 : 0;
+}